@@ -0,0 +1,479 @@
+/*
+ This file is part of qbce-prepro.
+
+ Copyright 2018 
+ Florian Lonsing, Vienna University of Technology, Austria.
+
+ qbce-prepro is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or (at
+ your option) any later version.
+
+ qbce-prepro is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with qbce-prepro.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "batch.h"
+#include "qbce-prepro.h"
+#include "parse.h"
+#include "error.h"
+
+/* One formula to be preprocessed. Every job has its own QBCEPrepro object
+   and hence its own memory manager. */
+struct BatchJob
+{
+  char *path;
+  QBCEPrepro *qr;
+  VarID num_vars;
+  unsigned int num_clauses;
+  unsigned int num_blocked;
+  size_t max_bytes;
+  double parse_time;
+  double qbce_time;
+  double output_time;
+  /* Statistics in JSON, if requested. */
+  char *json;
+  /* Message of the error the job failed with, if any. Failed jobs are
+     skipped but listed in the summary and the statistics. */
+  char *error;
+};
+
+typedef struct BatchJob BatchJob;
+
+/* Shared state of the thread pool. Jobs are parsed in the order of 'jobs',
+   the indices of parsed jobs are queued in 'parsed' until a worker picks
+   them up. */
+struct Batch
+{
+  BatchJob *jobs;
+  unsigned int num_jobs;
+  const char *out_dir;
+  const char *stats_json;
+  unsigned int mem_limit;
+  const char *pipeline;
+  unsigned int verbosity;
+  /* Accounts for the memory of all formulas in the pool, the memory
+     managers of the formulas are attached to it. */
+  MemMan *mm;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  /* Index of next job to be parsed. */
+  unsigned int next_unparsed;
+  /* Queue of parsed jobs: 'parsed[parsed_head..parsed_tail-1]'. */
+  unsigned int *parsed;
+  unsigned int parsed_head;
+  unsigned int parsed_tail;
+  /* Maximum number of parsed jobs the parse-ahead thread may queue. */
+  unsigned int max_queued;
+  /* Number of jobs being parsed right now. */
+  unsigned int num_parsing;
+};
+
+typedef struct Batch Batch;
+
+static const char *
+base_name (const char *path)
+{
+  const char *slash = strrchr (path, '/');
+  return slash ? slash + 1 : path;
+}
+
+static char *
+copy_string (const char *str)
+{
+  char *res = malloc (strlen (str) + 1);
+  ABORT_APP (!res, "could not allocate memory!");
+  return strcpy (res, str);
+}
+
+static void
+push_path (char ***paths, unsigned int *num, unsigned int *size, char *path)
+{
+  if (*num == *size)
+    {
+      *size = *size ? 2 * *size : 16;
+      *paths = realloc (*paths, *size * sizeof (char *));
+      ABORT_APP (!*paths, "could not allocate memory!");
+    }
+  (*paths)[(*num)++] = path;
+}
+
+static int
+compare_paths (const void *a, const void *b)
+{
+  return strcmp (*(char *const *) a, *(char *const *) b);
+}
+
+/* Collect paths of regular files in directory 'input', sorted by name, or
+   the paths listed line by line in file 'input'. */
+static char **
+collect_paths (const char *input, unsigned int *num)
+{
+  char **paths = 0;
+  unsigned int size = 0;
+  *num = 0;
+
+  DIR *dir = opendir (input);
+  if (dir)
+    {
+      struct dirent *entry;
+      while ((entry = readdir (dir)))
+        {
+          if (entry->d_name[0] == '.')
+            continue;
+          char *path = malloc (strlen (input) + strlen (entry->d_name) + 2);
+          ABORT_APP (!path, "could not allocate memory!");
+          sprintf (path, "%s/%s", input, entry->d_name);
+          struct stat st;
+          if (stat (path, &st) || !S_ISREG (st.st_mode))
+            {
+              free (path);
+              continue;
+            }
+          push_path (&paths, num, &size, path);
+        }
+      closedir (dir);
+      qsort (paths, *num, sizeof (char *), compare_paths);
+      return paths;
+    }
+
+  FILE *list = fopen (input, "r");
+  ABORT_APP (!list, "could not open batch input!");
+  char line[4096];
+  while (fgets (line, sizeof (line), list))
+    {
+      size_t len = strlen (line);
+      while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+        line[--len] = 0;
+      if (len)
+        push_path (&paths, num, &size, copy_string (line));
+    }
+  fclose (list);
+  return paths;
+}
+
+/* Record error 'msg' of 'job' and release its formula, if any. */
+static void
+fail_job (BatchJob * job, const char *msg)
+{
+  size_t len = strlen (msg);
+  /* Drop the trailing newline of some messages. */
+  while (len && msg[len - 1] == '\n')
+    len--;
+  job->error = malloc (len + 1);
+  ABORT_APP (!job->error, "could not allocate memory!");
+  memcpy (job->error, msg, len);
+  job->error[len] = 0;
+  if (job->qr)
+    {
+      qbce_recover (job->qr);
+      qbce_delete (job->qr);
+      job->qr = 0;
+    }
+}
+
+static void
+parse_job (Batch * b, BatchJob * job)
+{
+  double start = qbce_wall_time ();
+  FILE *in = fopen (job->path, "r");
+  if (!in)
+    {
+      fail_job (job, "could not open input file!");
+      return;
+    }
+  job->qr = qbce_create ();
+  job->qr->options.verbosity = b->verbosity;
+  mm_set_parent (job->qr->mm, b->mm);
+  if (b->pipeline)
+    qbce_set_pipeline (job->qr, b->pipeline);
+  if (b->mem_limit)
+    mm_set_mem_limit (job->qr->mm, b->mem_limit);
+
+  /* A malformed formula or exceeding the memory limit fails this job
+     only. */
+  jmp_buf recover;
+  if (setjmp (recover))
+    {
+      fclose (in);
+      fail_job (job, qbce_error_msg);
+      return;
+    }
+  qbce_error_jmp = &recover;
+  parse (job->qr, in);
+  ABORT_APP (job->qr->declared_num_clauses > job->qr->cur_clause_id,
+             "declared number of clauses exceeds actual number of clauses!");
+  qbce_error_jmp = 0;
+  fclose (in);
+  job->parse_time = qbce_wall_time () - start;
+}
+
+static void
+simplify_job (Batch * b, BatchJob * job)
+{
+  QBCEPrepro *qr = job->qr;
+  if (!qr)
+    return;
+  /* Output file, closed if an error is recovered from. */
+  FILE *volatile out = 0;
+  char *volatile out_path = 0;
+  jmp_buf recover;
+  if (setjmp (recover))
+    {
+      if (out)
+        fclose (out);
+      free (out_path);
+      fail_job (job, qbce_error_msg);
+      return;
+    }
+  qbce_error_jmp = &recover;
+
+  double start = qbce_wall_time ();
+  qbce_simplify (qr);
+  job->qbce_time = qbce_wall_time () - start;
+
+  if (b->out_dir)
+    {
+      start = qbce_wall_time ();
+      const char *name = base_name (job->path);
+      out_path = malloc (strlen (b->out_dir) + strlen (name) + 2);
+      ABORT_APP (!out_path, "could not allocate memory!");
+      sprintf (out_path, "%s/%s", b->out_dir, name);
+      out = fopen (out_path, "w");
+      ABORT_APP (!out, "could not open output file!");
+      qbce_print_formula (qr, out);
+      fclose (out);
+      out = 0;
+      free (out_path);
+      out_path = 0;
+      job->output_time = qbce_wall_time () - start;
+    }
+  qbce_error_jmp = 0;
+
+  job->num_vars = qr->pcnf.size_vars ? qr->pcnf.size_vars - 1 : 0;
+  job->num_clauses = qr->pcnf.clauses.cnt;
+  job->num_blocked = qr->cnt_blocked_clauses;
+  job->max_bytes = mm_max_allocated (qr->mm);
+  if (b->stats_json)
+    {
+      size_t size;
+      FILE *json = open_memstream (&job->json, &size);
+      ABORT_APP (!json, "could not allocate memory!");
+      qbce_print_stats_json (qr, json, job->path);
+      fclose (json);
+    }
+  qbce_delete (qr);
+  job->qr = 0;
+}
+
+/* Parse the next unparsed job and queue it. Called and returns with
+   'b->lock' held. */
+static void
+parse_next_job (Batch * b)
+{
+  BatchJob *job = b->jobs + b->next_unparsed++;
+  b->num_parsing++;
+  pthread_mutex_unlock (&b->lock);
+  parse_job (b, job);
+  pthread_mutex_lock (&b->lock);
+  b->num_parsing--;
+  b->parsed[b->parsed_tail++] = job - b->jobs;
+  pthread_cond_broadcast (&b->cond);
+}
+
+/* Parse-ahead thread: parses formulas while workers run QBCE, keeping at most
+   'max_queued' parsed formulas in memory. No formula is parsed ahead while
+   the memory limit of all formulas is approached. */
+static void *
+parser_thread (void *arg)
+{
+  Batch *b = arg;
+  pthread_mutex_lock (&b->lock);
+  while (b->next_unparsed < b->num_jobs)
+    {
+      unsigned int queued = b->parsed_tail - b->parsed_head;
+      if (queued >= b->max_queued
+          || (queued && mm_limit_approached (b->mm)))
+        pthread_cond_wait (&b->cond, &b->lock);
+      else
+        parse_next_job (b);
+    }
+  pthread_mutex_unlock (&b->lock);
+  return 0;
+}
+
+/* Worker thread: runs QBCE on parsed formulas. If no parsed formula is
+   available, the worker parses the next one itself rather than waiting. */
+static void *
+worker_thread (void *arg)
+{
+  Batch *b = arg;
+  pthread_mutex_lock (&b->lock);
+  for (;;)
+    {
+      if (b->parsed_head < b->parsed_tail)
+        {
+          BatchJob *job = b->jobs + b->parsed[b->parsed_head++];
+          pthread_cond_broadcast (&b->cond);
+          pthread_mutex_unlock (&b->lock);
+          simplify_job (b, job);
+          pthread_mutex_lock (&b->lock);
+        }
+      else if (b->next_unparsed < b->num_jobs)
+        parse_next_job (b);
+      else if (b->num_parsing)
+        pthread_cond_wait (&b->cond, &b->lock);
+      else
+        break;
+    }
+  pthread_mutex_unlock (&b->lock);
+  return 0;
+}
+
+static void
+print_summary (Batch * b, double wall)
+{
+  unsigned int i, num_failed = 0;
+  unsigned long long total_clauses = 0, total_blocked = 0;
+  double total_parse = 0, total_qbce = 0, total_output = 0;
+
+  fprintf (stdout, "%-40s %10s %10s %10s %7s %9s %9s %9s %10s\n", "file",
+           "vars", "clauses", "blocked", "%", "parse", "qbce", "output",
+           "max MB");
+  for (i = 0; i < b->num_jobs; i++)
+    {
+      BatchJob *job = b->jobs + i;
+      if (job->error)
+        {
+          fprintf (stdout, "%-40s error: %s\n", base_name (job->path),
+                   job->error);
+          num_failed++;
+          continue;
+        }
+      fprintf (stdout, "%-40s %10u %10u %10u %7.2f %9.3f %9.3f %9.3f %10.1f\n",
+               base_name (job->path), job->num_vars, job->num_clauses,
+               job->num_blocked, job->num_clauses ?
+               100.0 * job->num_blocked / job->num_clauses : 0,
+               job->parse_time, job->qbce_time, job->output_time,
+               job->max_bytes / 1024.0 / 1024.0);
+      total_clauses += job->num_clauses;
+      total_blocked += job->num_blocked;
+      total_parse += job->parse_time;
+      total_qbce += job->qbce_time;
+      total_output += job->output_time;
+    }
+  /* Peak of the formulas processed at the same time. */
+  fprintf (stdout, "%-40s %10s %10llu %10llu %7.2f %9.3f %9.3f %9.3f %10.1f\n",
+           "TOTAL", "", total_clauses, total_blocked, total_clauses ?
+           100.0 * total_blocked / total_clauses : 0, total_parse,
+           total_qbce, total_output,
+           mm_max_allocated (b->mm) / 1024.0 / 1024.0);
+  fprintf (stdout, "%u formulas, %u failed, wall time %.3f s\n", b->num_jobs,
+           num_failed, wall);
+}
+
+static void
+write_stats_json (Batch * b)
+{
+  FILE *out = fopen (b->stats_json, "w");
+  ABORT_APP (!out, "could not open statistics file!");
+  unsigned int i;
+  fprintf (out, "[\n");
+  for (i = 0; i < b->num_jobs; i++)
+    {
+      BatchJob *job = b->jobs + i;
+      if (job->error)
+        {
+          free (job->json);
+          size_t size;
+          FILE *json = open_memstream (&job->json, &size);
+          ABORT_APP (!json, "could not allocate memory!");
+          qbce_print_error_json (json, job->path, job->error);
+          fclose (json);
+        }
+      /* Drop the trailing newline of each object. */
+      size_t len = strlen (job->json);
+      fprintf (out, "%.*s%s\n", (int) (len ? len - 1 : 0), job->json,
+               i + 1 < b->num_jobs ? "," : "");
+    }
+  fprintf (out, "]\n");
+  fclose (out);
+}
+
+unsigned int
+run_batch (const char *input, const char *out_dir, const char *stats_json,
+           unsigned int num_workers, unsigned int mem_limit,
+           unsigned int total_mem_limit, const char *pipeline,
+           unsigned int verbosity)
+{
+  double start = qbce_wall_time ();
+  Batch b;
+  memset (&b, 0, sizeof (Batch));
+  char **paths = collect_paths (input, &b.num_jobs);
+  b.out_dir = out_dir;
+  b.stats_json = stats_json;
+  b.mem_limit = mem_limit;
+  b.pipeline = pipeline;
+  b.mm = mm_create ();
+  if (total_mem_limit)
+    mm_set_mem_limit (b.mm, total_mem_limit);
+  b.verbosity = verbosity;
+  b.max_queued = num_workers;
+  b.jobs = calloc (b.num_jobs + 1, sizeof (BatchJob));
+  b.parsed = calloc (b.num_jobs + 1, sizeof (unsigned int));
+  ABORT_APP (!b.jobs || !b.parsed, "could not allocate memory!");
+  unsigned int i;
+  for (i = 0; i < b.num_jobs; i++)
+    b.jobs[i].path = paths[i];
+  pthread_mutex_init (&b.lock, 0);
+  pthread_cond_init (&b.cond, 0);
+
+  assert (num_workers > 0);
+  pthread_t *threads = malloc ((num_workers + 1) * sizeof (pthread_t));
+  ABORT_APP (!threads, "could not allocate memory!");
+  ABORT_APP (pthread_create (threads, 0, parser_thread, &b),
+             "could not create thread!");
+  for (i = 1; i <= num_workers; i++)
+    ABORT_APP (pthread_create (threads + i, 0, worker_thread, &b),
+               "could not create thread!");
+  for (i = 0; i <= num_workers; i++)
+    pthread_join (threads[i], 0);
+
+  print_summary (&b, qbce_wall_time () - start);
+  if (stats_json)
+    write_stats_json (&b);
+
+  pthread_cond_destroy (&b.cond);
+  pthread_mutex_destroy (&b.lock);
+  unsigned int num_failed = 0;
+  for (i = 0; i < b.num_jobs; i++)
+    {
+      num_failed += b.jobs[i].error != 0;
+      free (b.jobs[i].path);
+      free (b.jobs[i].json);
+      free (b.jobs[i].error);
+    }
+  free (threads);
+  free (paths);
+  free (b.parsed);
+  free (b.jobs);
+  mm_delete (b.mm);
+  return num_failed;
+}
@@ -0,0 +1,43 @@
+/*
+ This file is part of qbce-prepro.
+
+ Copyright 2018 
+ Florian Lonsing, Vienna University of Technology, Austria.
+
+ qbce-prepro is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or (at
+ your option) any later version.
+
+ qbce-prepro is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with qbce-prepro.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BATCH_H_INCLUDED
+#define BATCH_H_INCLUDED
+
+/* Preprocess all formulas in directory 'input' or listed in file 'input'
+   (one path per line) in one process, using 'num_workers' threads for QBCE
+   and one additional thread parsing formulas ahead. If 'out_dir' is not
+   null, then the simplified formulas are written to files in 'out_dir'
+   named like the input files. A table with statistics for every formula is
+   printed to stdout. If 'stats_json' is not null, then the statistics of all
+   formulas are written to file 'stats_json' as JSON array. If 'mem_limit'
+   is nonzero, then it limits the memory per formula in MB. Likewise,
+   'total_mem_limit' limits the memory of all formulas processed at the
+   same time. If not null, 'pipeline' sets the simplification stages (see
+   'qbce_set_pipeline'). A formula which cannot be read or exceeds the
+   memory limit is skipped and listed with its error. Returns the number of
+   such formulas. */
+unsigned int run_batch (const char *input, const char *out_dir,
+                        const char *stats_json, unsigned int num_workers,
+                        unsigned int mem_limit, unsigned int total_mem_limit,
+                        const char *pipeline, unsigned int verbosity);
+
+#endif
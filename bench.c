@@ -0,0 +1,271 @@
+/*
+ This file is part of qbce-prepro.
+
+ Copyright 2018 
+ Florian Lonsing, Vienna University of Technology, Austria.
+
+ qbce-prepro is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or (at
+ your option) any later version.
+
+ qbce-prepro is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with qbce-prepro.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* Benchmark driver: measures parsing, QBCE and output separately on a set
+   of formulas, repeated several times. Reports median and minimum time and
+   throughput per phase and peak memory, and compares the medians with a
+   baseline file saved by an earlier run. */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "qbce-prepro.h"
+#include "parse.h"
+#include "error.h"
+
+#define BENCH_USAGE \
+"usage: ./qbce-bench [options] formula ...\n"\
+"\n"\
+"    -r <n>             repeat each measurement <n> times (default: 5)\n"\
+"    --baseline=<f>     compare median times with baseline file <f>\n"\
+"    --save=<f>         save median times as baseline file <f>\n"\
+"    --threshold=<p>    report phases slower than baseline by more than\n"\
+"                         <p> percent as regression (default: 10)\n"\
+"\n"
+
+#define BENCH_NOISE_FLOOR 0.001
+
+enum BenchPhase
+{
+  PHASE_PARSE = 0,
+  PHASE_QBCE = 1,
+  PHASE_OUTPUT = 2,
+  NUM_PHASES = 3
+};
+
+static const char *phase_names[NUM_PHASES] = { "parse", "qbce", "output" };
+
+/* Measurements of one formula. */
+struct BenchResult
+{
+  const char *path;
+  size_t input_bytes;
+  size_t output_bytes;
+  unsigned int num_clauses;
+  unsigned int num_blocked;
+  size_t max_bytes;
+  /* Wall clock times of all repetitions, per phase. */
+  double *times[NUM_PHASES];
+};
+
+typedef struct BenchResult BenchResult;
+
+static char *
+read_file (const char *path, size_t * size)
+{
+  FILE *in = fopen (path, "r");
+  ABORT_APP (!in, "could not open formula!");
+  struct stat st;
+  ABORT_APP (fstat (fileno (in), &st), "could not stat formula!");
+  *size = st.st_size;
+  char *buf = malloc (*size + 1);
+  ABORT_APP (!buf, "could not allocate memory!");
+  ABORT_APP (fread (buf, 1, *size, in) != *size, "could not read formula!");
+  fclose (in);
+  return buf;
+}
+
+/* Run all phases once on the formula in 'buf'. Parsing reads from memory to
+   exclude disk I/O, output goes to a temporary file. */
+static void
+run_once (BenchResult * res, char *buf, size_t size, unsigned int rep)
+{
+  QBCEPrepro *qr = qbce_create ();
+  FILE *in = fmemopen (buf, size, "r");
+  ABORT_APP (!in, "could not open formula in memory!");
+  parse (qr, in);
+  fclose (in);
+
+  qbce_find_blocked_clauses (qr);
+
+  FILE *out = tmpfile ();
+  ABORT_APP (!out, "could not open temporary file!");
+  qbce_print_formula (qr, out);
+  struct stat st;
+  ABORT_APP (fstat (fileno (out), &st), "could not stat output!");
+  fclose (out);
+
+  QBCEStats *stats = &qr->stats;
+  res->times[PHASE_PARSE][rep] = stats->parse.wall + stats->occurrences.wall;
+  res->times[PHASE_QBCE][rep] = stats->qbce.wall;
+  res->times[PHASE_OUTPUT][rep] = stats->output.wall;
+  res->output_bytes = st.st_size;
+  res->num_clauses = qr->pcnf.clauses.cnt;
+  res->num_blocked = qr->cnt_blocked_clauses;
+  res->max_bytes = mm_max_allocated (qr->mm);
+  qbce_delete (qr);
+}
+
+static int
+compare_doubles (const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return x < y ? -1 : x > y;
+}
+
+/* Sort 'times' and return median. */
+static double
+median (double *times, unsigned int num)
+{
+  qsort (times, num, sizeof (double), compare_doubles);
+  return num % 2 ? times[num / 2] : (times[num / 2 - 1] + times[num / 2]) / 2;
+}
+
+/* Look up the median time of 'phase' on formula 'path' in 'baseline', which
+   holds lines 'path phase median min'. Returns a negative value if the
+   baseline has no entry. */
+static double
+lookup_baseline (FILE * baseline, const char *path, const char *phase)
+{
+  char bpath[4096], bphase[64];
+  double bmedian, bmin;
+  rewind (baseline);
+  while (fscanf (baseline, "%4095s %63s %lf %lf", bpath, bphase, &bmedian,
+                 &bmin) == 4)
+    if (!strcmp (bpath, path) && !strcmp (bphase, phase))
+      return bmedian;
+  return -1;
+}
+
+static double
+throughput (double amount, double time)
+{
+  return time > 0 ? amount / time : 0;
+}
+
+/* Print results of all phases of 'res' and compare with 'baseline'. Returns
+   the number of regressions. */
+static unsigned int
+report (BenchResult * res, unsigned int reps, FILE * baseline, FILE * save,
+        double threshold)
+{
+  unsigned int regressions = 0, p;
+  fprintf (stdout, "%s: %u clauses, %u blocked, %.1f MB input, "
+           "%.1f MB output, peak memory %.1f MB\n", res->path,
+           res->num_clauses, res->num_blocked, res->input_bytes / 1e6,
+           res->output_bytes / 1e6, res->max_bytes / 1024.0 / 1024.0);
+  for (p = 0; p < NUM_PHASES; p++)
+    {
+      double med = median (res->times[p], reps), min = res->times[p][0];
+      /* Parsing is measured against input size, output against output
+         size and QBCE against the number of clauses only. */
+      double bytes = p == PHASE_PARSE ? res->input_bytes :
+        p == PHASE_OUTPUT ? res->output_bytes : 0;
+      fprintf (stdout, "  %-7s median %9.4f s  min %9.4f s  %12.0f clauses/s",
+               phase_names[p], med, min,
+               throughput (res->num_clauses, med));
+      if (bytes)
+        fprintf (stdout, "  %8.1f MB/s (best %8.1f MB/s)",
+                 throughput (bytes / 1e6, med), throughput (bytes / 1e6, min));
+      if (baseline)
+        {
+          double base = lookup_baseline (baseline, res->path, phase_names[p]);
+          if (base > 0)
+            {
+              double change = 100 * (med - base) / base;
+              /* Phases faster than 'BENCH_NOISE_FLOOR' seconds are too noisy
+                 to be reported as regression. */
+              int slower = change > threshold && base >= BENCH_NOISE_FLOOR;
+              regressions += slower;
+              fprintf (stdout, "  %+6.1f%% vs baseline%s", change,
+                       slower ? "  REGRESSION" : "");
+            }
+        }
+      fprintf (stdout, "\n");
+      if (save)
+        fprintf (save, "%s %s %.6f %.6f\n", res->path, phase_names[p], med,
+                 min);
+    }
+  return regressions;
+}
+
+int
+main (int argc, char **argv)
+{
+  unsigned int reps = 5, regressions = 0;
+  double threshold = 10;
+  const char *baseline_path = 0, *save_path = 0;
+  int i;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+      if (!strcmp (argv[i], "-r") && i + 1 < argc)
+        reps = atoi (argv[++i]);
+      else if (!strncmp (argv[i], "--baseline=", strlen ("--baseline=")))
+        baseline_path = argv[i] + strlen ("--baseline=");
+      else if (!strncmp (argv[i], "--save=", strlen ("--save=")))
+        save_path = argv[i] + strlen ("--save=");
+      else if (!strncmp (argv[i], "--threshold=", strlen ("--threshold=")))
+        threshold = atof (argv[i] + strlen ("--threshold="));
+      else
+        {
+          fprintf (stderr, BENCH_USAGE);
+          return 1;
+        }
+    }
+  if (i == argc || !reps)
+    {
+      fprintf (stderr, BENCH_USAGE);
+      return 1;
+    }
+
+  FILE *baseline = 0, *save = 0;
+  if (baseline_path)
+    ABORT_APP (!(baseline = fopen (baseline_path, "r")),
+               "could not open baseline file!");
+  if (save_path)
+    ABORT_APP (!(save = fopen (save_path, "w")),
+               "could not open file to save baseline!");
+
+  fprintf (stdout, "%u repetitions per formula\n", reps);
+  double start = qbce_wall_time ();
+  for (; i < argc; i++)
+    {
+      BenchResult res;
+      memset (&res, 0, sizeof (BenchResult));
+      res.path = argv[i];
+      unsigned int p, rep;
+      for (p = 0; p < NUM_PHASES; p++)
+        ABORT_APP (!(res.times[p] = malloc (reps * sizeof (double))),
+                   "could not allocate memory!");
+      char *buf = read_file (res.path, &res.input_bytes);
+      for (rep = 0; rep < reps; rep++)
+        run_once (&res, buf, res.input_bytes, rep);
+      free (buf);
+      regressions += report (&res, reps, baseline, save, threshold);
+      for (p = 0; p < NUM_PHASES; p++)
+        free (res.times[p]);
+    }
+
+  fprintf (stdout, "total wall time %.3f s\n", qbce_wall_time () - start);
+  if (baseline)
+    {
+      fclose (baseline);
+      fprintf (stdout, "%u regressions (threshold %.1f%%)\n", regressions,
+               threshold);
+    }
+  if (save)
+    fclose (save);
+  return regressions ? 2 : 0;
+}
@@ -0,0 +1,197 @@
+#!/bin/bash
+
+# Checks that options which change how formulas are read, stored or written,
+# the batch and server modes and the benchmark driver give the output
+# expected from a single run in the default mode, byte by byte. Runs on the
+# given formulas and on a larger generated one.
+#
+# usage: ./check-modes.sh <formula>...
+
+TMPDIR=$(mktemp -d)
+trap 'rm -rf $TMPDIR' EXIT
+FAILED=0
+
+# Report failure 'msg'.
+fail ()
+{
+    echo "FAILURE: $1"
+    ((FAILED++))
+}
+
+# Simplify formula 'f' with the options following it and print the result.
+simplify ()
+{
+    local f=$1
+    shift
+    ./qbce-prepro $f --print-formula --simplify "$@"
+}
+
+# Send formula 'f' to the server listening on socket 'sock' and print the
+# response. If formula 'stalled' is given, it is sent first by a client
+# which keeps the connection open after the response, and the server is
+# given 30 seconds to respond to 'f'.
+request ()
+{
+    python3 - "$@" <<'END'
+import socket, sys
+
+def connect(path):
+    s = socket.socket(socket.AF_UNIX)
+    s.settimeout(30)
+    s.connect(sys.argv[1])
+    with open(path, "rb") as f:
+        s.sendall(f.read())
+    return s
+
+def receive(s):
+    response = b""
+    while True:
+        data = s.recv(1 << 16)
+        if not data:
+            return response
+        response += data
+
+if len(sys.argv) > 3:
+    stalled = connect(sys.argv[3])
+    receive(stalled)
+s = connect(sys.argv[2])
+s.shutdown(socket.SHUT_WR)
+sys.stdout.buffer.write(receive(s))
+END
+}
+
+mkdir $TMPDIR/external
+./qbce-gen --vars=20000 --clauses=100000 --depth=4 --planted=0.1 --seed=1 \
+    -o $TMPDIR/generated.qdimacs || exit 1
+
+for F in "$@" $TMPDIR/generated.qdimacs
+do
+    NAME=$(basename $F)
+    simplify $F > $TMPDIR/ref.qdimacs || { fail "$NAME"; continue; }
+
+    # Every clause twice: dropping duplicates gives the original formula,
+    # unless it had duplicates already.
+    awk '/^p/ { $4 *= 2; print; next } /^[cae]/ { print; next }
+         { print; dup[n++] = $0 } END { for (i = 0; i < n; i++) print dup[i] }' \
+        $F > $TMPDIR/dup.qdimacs
+    simplify $F --dedup > $TMPDIR/dedup.qdimacs
+    simplify $TMPDIR/dup.qdimacs --dedup | cmp -s - $TMPDIR/dedup.qdimacs \
+        || fail "$NAME: --dedup does not drop duplicates"
+
+    # Variable v renamed to 3v+1000: compaction prints the sparse IDs
+    # again, and renumbering gives the same IDs as for the original.
+    awk 'function sparse(x) { return x < 0 ? -sparse(-x) : 3 * x + 1000 }
+         /^p/ { $3 = sparse($3); print; next } /^c/ { print; next }
+         { line = $1 ~ /^[ae]$/ || $1 == 0 ? $1 : sparse($1)
+           for (i = 2; i <= NF; i++)
+             line = line " " ($i == 0 ? 0 : sparse($i))
+           print line }' $F > $TMPDIR/sparse.qdimacs
+    simplify $TMPDIR/sparse.qdimacs --compact-vars \
+        | cmp -s - <(simplify $TMPDIR/sparse.qdimacs) \
+        || fail "$NAME: --compact-vars changes the output"
+    simplify $TMPDIR/sparse.qdimacs --compact-vars=renumber \
+        | cmp -s - <(simplify $F --compact-vars=renumber) \
+        || fail "$NAME: --compact-vars=renumber depends on the IDs"
+
+    # Relabeling and clause layout must not show in the output.
+    simplify $F --reorder | cmp -s - $TMPDIR/ref.qdimacs \
+        || fail "$NAME: --reorder changes the output"
+    simplify $F --reorder --compact-vars=renumber --dedup \
+        | cmp -s - <(simplify $F --compact-vars=renumber --dedup) \
+        || fail "$NAME: --reorder changes the output of renumbering"
+
+    # Clauses formatted in parallel are written in formula order, with and
+    # without simplification and with variables mapped back after
+    # compaction.
+    for THREADS in 2 4
+    do
+        simplify $F --output-threads=$THREADS | cmp -s - $TMPDIR/ref.qdimacs \
+            || fail "$NAME: --output-threads=$THREADS changes the output"
+    done
+    ./qbce-prepro $F --print-formula --output-threads=4 \
+        | cmp -s - <(./qbce-prepro $F --print-formula) \
+        || fail "$NAME: --output-threads=4 changes the parsed formula"
+    simplify $TMPDIR/sparse.qdimacs --compact-vars --output-threads=4 \
+        | cmp -s - <(simplify $TMPDIR/sparse.qdimacs) \
+        || fail "$NAME: --output-threads=4 changes the compacted output"
+
+    ./test-lib --print-stream $F \
+        || fail "$NAME: printing to a stream without file descriptor"
+
+    # Clauses and occurrence lists in a mapped file, with pages dropped
+    # after every MB touched.
+    simplify $F --external-mem=$TMPDIR/external --external-rss=1 \
+        | cmp -s - $TMPDIR/ref.qdimacs \
+        || fail "$NAME: --external-mem changes the output"
+done
+
+# Resuming from a checkpoint written in the last round of QBCE must give the
+# same result as running QBCE in one go. Checkpoints are written up to once
+# per 1024 variables, which takes long on the large given formulas, hence
+# only the generated one is checked.
+F=$TMPDIR/generated.qdimacs
+./test-lib --checkpoint=$TMPDIR/checkpoint $F \
+    || fail "resuming from a checkpoint in the library"
+simplify $F --checkpoint=$TMPDIR/checkpoint --resume \
+    | cmp -s - <(simplify $F) || fail "--resume changes the output"
+
+# Batch mode writes the output of each formula to the output directory,
+# and reports a malformed formula without stopping the others.
+mkdir $TMPDIR/batch $TMPDIR/batch-out
+cp "$@" $TMPDIR/generated.qdimacs $TMPDIR/batch
+echo "p cnf 1 1" > $TMPDIR/batch/malformed.qdimacs
+./qbce-prepro $TMPDIR/batch --batch --jobs=2 --out-dir=$TMPDIR/batch-out \
+    --simplify > $TMPDIR/batch.txt
+(($? == 1)) && grep -q "^malformed.qdimacs *error:" $TMPDIR/batch.txt \
+    || fail "--batch does not report the malformed formula"
+for F in "$@" $TMPDIR/generated.qdimacs
+do
+    NAME=$(basename $F)
+    simplify $F | cmp -s - $TMPDIR/batch-out/$NAME \
+        || fail "$NAME: --batch changes the output"
+done
+
+# The server responds with the simplified formula followed by comment
+# lines, and survives a malformed request. Its only worker is not tied up
+# by a client which keeps a failed request open.
+SOCK=$TMPDIR/server.sock
+./qbce-prepro --server=$SOCK --jobs=1 --simplify > /dev/null 2>&1 &
+SERVER=$!
+for ((i = 0; i < 50; i++))
+do
+    [[ -S $SOCK ]] && break
+    sleep 0.1
+done
+request $SOCK $TMPDIR/batch/malformed.qdimacs | grep -q "^c error:" \
+    || fail "server does not report the malformed request"
+printf "p cnf 2 1\nx 1 0\n" > $TMPDIR/invalid.qdimacs
+F=$TMPDIR/generated.qdimacs
+request $SOCK $F $TMPDIR/invalid.qdimacs 2> /dev/null | grep -v "^c" \
+    | cmp -s - <(simplify $F) \
+    || fail "server is stalled by a failed request left open by the client"
+for F in "$@" $TMPDIR/generated.qdimacs
+do
+    NAME=$(basename $F)
+    request $SOCK $F | grep -v "^c" | cmp -s - <(simplify $F) \
+        || fail "$NAME: --server changes the output"
+done
+kill $SERVER
+wait $SERVER 2> /dev/null
+
+# The benchmark driver reports the clauses QBCE leaves in a single run,
+# saves a baseline with every phase and compares with it.
+for F in "$@" $TMPDIR/generated.qdimacs
+do
+    NAME=$(basename $F)
+    ./qbce-bench -r 1 --save=$TMPDIR/baseline $F > $TMPDIR/bench.txt \
+        && ./qbce-bench -r 1 --baseline=$TMPDIR/baseline --threshold=1000000 \
+               $F > /dev/null \
+        && [[ $(wc -l < $TMPDIR/baseline) == 3 ]] \
+        || fail "$NAME: qbce-bench exited with error"
+    LEFT=$(awk '/clauses, .* blocked/ { print $2 - $4 }' $TMPDIR/bench.txt)
+    [[ $LEFT == $(simplify $F | awk '/^p/ { print $4 }') ]] \
+        || fail "$NAME: qbce-bench blocks other clauses"
+done
+
+echo "$# formulas and a generated one, $FAILED failures"
+((FAILED == 0))
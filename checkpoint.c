@@ -0,0 +1,222 @@
+/*
+ This file is part of qbce-prepro.
+
+ Copyright 2018 
+ Florian Lonsing, Vienna University of Technology, Austria.
+
+ qbce-prepro is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or (at
+ your option) any later version.
+
+ qbce-prepro is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with qbce-prepro.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "checkpoint.h"
+#include "error.h"
+
+/* Magic number at the start of a checkpoint, including a format version. */
+#define CHECKPOINT_MAGIC "QBCECKP1"
+
+/* Parameters of the 64-bit FNV-1a hash. */
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+/* Fixed-size start of a checkpoint. It is followed by a bitmap of the
+   blocked clauses in the order of the formula, the blocking literals of
+   the blocked clauses in the same order and a bitmap of the literal marks,
+   with 'mark0' and 'mark1' of variable 'v' at bits '2 * v' and
+   '2 * v + 1'. */
+struct CheckpointHeader
+{
+  char magic[8];
+  unsigned long long hash;
+  unsigned int size_vars;
+  unsigned int num_clauses;
+  unsigned int num_blocked;
+  unsigned int reserved;
+};
+
+typedef struct CheckpointHeader CheckpointHeader;
+
+#define BITMAP_BYTES(bits) (((size_t) (bits) + 7) / 8)
+#define BIT_SET(map, i) ((map)[(i) / 8] & (1 << ((i) % 8)))
+#define SET_BIT(map, i) ((map)[(i) / 8] |= (1 << ((i) % 8)))
+
+static unsigned long long
+hash_int (unsigned long long hash, unsigned int num)
+{
+  int i;
+  for (i = 0; i < 4; i++, num >>= 8)
+    {
+      hash ^= num & 0xff;
+      hash *= FNV_PRIME;
+    }
+  return hash;
+}
+
+unsigned long long
+qbce_formula_hash (QBCEPrepro * qr)
+{
+  unsigned long long hash = hash_int (FNV_OFFSET, qr->pcnf.size_vars);
+  Scope *s;
+  for (s = qr->pcnf.scopes.first; s; s = s->link.next)
+    {
+      hash = hash_int (hash, (unsigned int) s->type);
+      VarID *p, *e;
+      for (p = s->vars.start, e = s->vars.top; p < e; p++)
+        hash = hash_int (hash, *p);
+      hash = hash_int (hash, 0);
+    }
+  Clause *c;
+  for (c = qr->pcnf.clauses.first; c; c = c->link.next)
+    {
+      LitID *p, *e;
+      for (p = c->lits, e = p + c->num_lits; p < e; p++)
+        hash = hash_int (hash, (unsigned int) *p);
+      hash = hash_int (hash, 0);
+    }
+  return hash;
+}
+
+int
+qbce_write_checkpoint (QBCEPrepro * qr, const char *path)
+{
+  size_t len = strlen (path);
+  char *tmp = mm_malloc (qr->mm, len + 5);
+  memcpy (tmp, path, len);
+  memcpy (tmp + len, ".tmp", 5);
+  FILE *out = fopen (tmp, "wb");
+  if (!out)
+    {
+      mm_free (qr->mm, tmp, len + 5);
+      return 0;
+    }
+
+  CheckpointHeader header;
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, CHECKPOINT_MAGIC, sizeof (header.magic));
+  header.hash = qbce_formula_hash (qr);
+  header.size_vars = qr->pcnf.size_vars;
+  header.num_clauses = qr->pcnf.clauses.cnt;
+  header.num_blocked = qr->cnt_blocked_clauses;
+  int ok = fwrite (&header, sizeof (header), 1, out) == 1;
+
+  size_t blocked_bytes = BITMAP_BYTES (header.num_clauses);
+  size_t mark_bytes = BITMAP_BYTES (2 * (size_t) header.size_vars);
+  unsigned char *map = mm_malloc (qr->mm, blocked_bytes > mark_bytes ?
+                                  blocked_bytes : mark_bytes);
+  Clause *c;
+  size_t i;
+  for (c = qr->pcnf.clauses.first, i = 0; c; c = c->link.next, i++)
+    if (c->blocked)
+      SET_BIT (map, i);
+  ok = ok && fwrite (map, 1, blocked_bytes, out) == blocked_bytes;
+  for (c = qr->pcnf.clauses.first; ok && c; c = c->link.next)
+    if (c->blocked)
+      ok = fwrite (&c->blocking_lit, sizeof (LitID), 1, out) == 1;
+
+  memset (map, 0, mark_bytes);
+  Var *vars = qr->pcnf.vars;
+  for (i = 0; i < header.size_vars; i++)
+    {
+      if (vars[i].mark0)
+        SET_BIT (map, 2 * i);
+      if (vars[i].mark1)
+        SET_BIT (map, 2 * i + 1);
+    }
+  ok = ok && fwrite (map, 1, mark_bytes, out) == mark_bytes;
+  mm_free (qr->mm, map, blocked_bytes > mark_bytes ?
+           blocked_bytes : mark_bytes);
+
+  ok = !fclose (out) && ok;
+  ok = ok && !rename (tmp, path);
+  if (!ok)
+    remove (tmp);
+  mm_free (qr->mm, tmp, len + 5);
+  return ok;
+}
+
+/* Return nonzero if 'lit' occurs in 'clause'. */
+static int
+has_literal (Clause * clause, LitID lit)
+{
+  LitID *p, *e;
+  for (p = clause->lits, e = p + clause->num_lits; p < e; p++)
+    if (*p == lit)
+      return 1;
+  return 0;
+}
+
+int
+qbce_read_checkpoint (QBCEPrepro * qr, const char *path)
+{
+  FILE *in = fopen (path, "rb");
+  if (!in)
+    return 0;
+
+  CheckpointHeader header;
+  if (fread (&header, sizeof (header), 1, in) != 1 ||
+      memcmp (header.magic, CHECKPOINT_MAGIC, sizeof (header.magic)) ||
+      header.size_vars != qr->pcnf.size_vars ||
+      header.num_clauses != qr->pcnf.clauses.cnt ||
+      header.num_blocked > header.num_clauses ||
+      header.hash != qbce_formula_hash (qr))
+    {
+      fclose (in);
+      return -1;
+    }
+
+  /* Read and check everything before changing the formula. */
+  size_t blocked_bytes = BITMAP_BYTES (header.num_clauses);
+  size_t mark_bytes = BITMAP_BYTES (2 * (size_t) header.size_vars);
+  size_t lit_bytes = header.num_blocked * sizeof (LitID);
+  unsigned char *blocked = mm_malloc (qr->mm, blocked_bytes + 1);
+  unsigned char *marks = mm_malloc (qr->mm, mark_bytes + 1);
+  LitID *lits = mm_malloc (qr->mm, lit_bytes + sizeof (LitID));
+  int ok = fread (blocked, 1, blocked_bytes, in) == blocked_bytes &&
+    fread (lits, 1, lit_bytes, in) == lit_bytes &&
+    fread (marks, 1, mark_bytes, in) == mark_bytes && fgetc (in) == EOF;
+  fclose (in);
+
+  Clause *c;
+  size_t i, k;
+  for (c = qr->pcnf.clauses.first, i = k = 0; ok && c; c = c->link.next, i++)
+    if (BIT_SET (blocked, i))
+      ok = k < header.num_blocked && has_literal (c, lits[k++]);
+  ok = ok && k == header.num_blocked;
+
+  if (ok)
+    {
+      for (c = qr->pcnf.clauses.first, i = k = 0; c; c = c->link.next, i++)
+        if (BIT_SET (blocked, i))
+          {
+            c->blocked = 1;
+            c->blocking_lit = lits[k++];
+          }
+      qr->cnt_blocked_clauses = header.num_blocked;
+      Var *vars = qr->pcnf.vars;
+      for (i = 0; i < header.size_vars; i++)
+        {
+          vars[i].mark0 = BIT_SET (marks, 2 * i) != 0;
+          vars[i].mark1 = BIT_SET (marks, 2 * i + 1) != 0;
+        }
+      qr->qbce_seeded = 1;
+    }
+
+  mm_free (qr->mm, lits, lit_bytes + sizeof (LitID));
+  mm_free (qr->mm, marks, mark_bytes + 1);
+  mm_free (qr->mm, blocked, blocked_bytes + 1);
+  return ok ? 1 : -1;
+}
@@ -0,0 +1,48 @@
+/*
+ This file is part of qbce-prepro.
+
+ Copyright 2018 
+ Florian Lonsing, Vienna University of Technology, Austria.
+
+ qbce-prepro is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or (at
+ your option) any later version.
+
+ qbce-prepro is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with qbce-prepro.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CHECKPOINT_H_INCLUDED
+#define CHECKPOINT_H_INCLUDED
+
+#include "qbce-prepro.h"
+
+/* Checkpoints of QBCE. A checkpoint stores the blocked clauses with their
+   blocking literals and the literal marks of QBCE still pending, which is
+   all the state needed to continue the fixed-point iteration. It is keyed
+   to a hash of the formula, which must be the same when resuming, including
+   the effect of '--dedup', '--compact-vars' and '--reorder'. Since other
+   simplification stages change the formula, checkpoints are only supported
+   for QBCE alone. */
+
+/* Hash of the prefix and the clauses of the formula. */
+unsigned long long qbce_formula_hash (QBCEPrepro * qr);
+
+/* Write a checkpoint to file 'path', replacing it atomically by writing to
+   a temporary file first. Returns zero on failure. */
+int qbce_write_checkpoint (QBCEPrepro * qr, const char *path);
+
+/* Restore the state of a checkpoint from file 'path' into the freshly
+   parsed formula. Returns 1 on success, 0 if there is no checkpoint and -1
+   if it does not match the formula or is corrupt, where the formula is left
+   unchanged in the latter two cases. */
+int qbce_read_checkpoint (QBCEPrepro * qr, const char *path);
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ This file is part of qbce-prepro.
+
+ Copyright 2018 
+ Florian Lonsing, Vienna University of Technology, Austria.
+
+ qbce-prepro is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or (at
+ your option) any later version.
+
+ qbce-prepro is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with qbce-prepro.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "error.h"
+
+__thread jmp_buf *qbce_error_jmp;
+__thread const char *qbce_error_msg;
+
+/* Report error 'msg' raised in function 'func' at line 'line' of the
+   module named 'prefix'. */
+void
+qbce_error (const char *prefix, const char *func, int line, const char *msg)
+{
+  jmp_buf *recover = qbce_error_jmp;
+  if (recover)
+    {
+      qbce_error_jmp = 0;
+      qbce_error_msg = msg;
+      longjmp (*recover, 1);
+    }
+  fprintf (stderr, "[%s] %s at line %d: %s\n", prefix, func, line, msg);
+  fflush (stderr);
+  abort ();
+}
@@ -21,19 +21,30 @@
 #ifndef ERROR_H_INCLUDED
 #define ERROR_H_INCLUDED
 
+#include <setjmp.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+/* Errors abort the program, unless the calling thread set a recovery point
+   in 'qbce_error_jmp'. Then the message is kept in 'qbce_error_msg' and the
+   error jumps to the recovery point by 'longjmp' instead, which clears it.
+   This allows servers and batch workers to report a malformed formula or
+   an exceeded memory limit and to go on with the next formula, after
+   releasing the failed one by 'qbce_recover'. */
+extern __thread jmp_buf *qbce_error_jmp;
+extern __thread const char *qbce_error_msg;
+
+#ifdef __GNUC__
+__attribute__ ((noreturn))
+#endif
+void qbce_error (const char *prefix, const char *func, int line,
+                 const char *msg);
+
 /* Macro to print message and abort. */
 #define ABORT_APP(cond,msg)                                       \
   do {                                                                  \
     if (cond)                                                           \
-      {                                                                 \
-        fprintf (stderr, "[QBCE-PREPRO] %s at line %d: %s\n", __func__,   \
-                 __LINE__, msg);                                        \
-        fflush (stderr);                                                \
-        abort();                                                        \
-      }                                                                 \
+      qbce_error ("QBCE-PREPRO", __func__, __LINE__, msg);              \
   } while (0)
 
 #endif
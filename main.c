@@ -0,0 +1,518 @@
+/*
+ This file is part of qbce-prepro.
+
+ Copyright 2018 
+ Florian Lonsing, Vienna University of Technology, Austria.
+
+ qbce-prepro is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or (at
+ your option) any later version.
+
+ qbce-prepro is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with qbce-prepro.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <sys/resource.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <assert.h>
+#include <string.h>
+#include <stdarg.h>
+#include <signal.h>
+#include <unistd.h>
+#include "qbce-prepro.h"
+#include "parse.h"
+#include "error.h"
+#include "batch.h"
+#include "server.h"
+#include "checkpoint.h"
+
+/* -------------------- START: Helper macros -------------------- */
+
+#define USAGE \
+"usage: ./qbce-prepro [options] input-formula [timeout]\n"\
+"\n"\
+"  - 'input-formula' is a file in QDIMACS format (default: stdin)\n"\
+"  - '[timeout]' is an optional timeout in seconds\n"\
+"  - '[options]' is any combination of the following:\n\n"\
+"    -h, --help         print this usage information and exit\n"\
+"    --simplify         detect and mark blocked clauses\n"\
+"    --pipeline=<list>  comma-separated list of simplification stages run\n"\
+"                         in this order until none of them changes the\n"\
+"                         formula: 'ur' (universal reduction), 'up' (unit\n"\
+"                         propagation), 'pure' (pure literals), 'qbce',\n"\
+"                         'qhbce' (hidden QBCE), 'qcbce' (covered QBCE),\n"\
+"                         'qble' (blocked universal literals), 'bve'\n"\
+"                         (bounded variable elimination) and 'sub'\n"\
+"                         (subsumption and self-subsuming resolution)\n"\
+"                         (default: qbce)\n"\
+"    --ala              extend clauses also by asymmetric literal addition\n"\
+"                         in 'qhbce' and 'qcbce'\n"\
+"    --ext-effort=<n>   maximum number of literal visits for extending one\n"\
+"                         clause in 'qhbce' and 'qcbce' (default: 10000)\n"\
+"    --bve-clause-bound=<n>  number of clauses by which 'bve' may increase\n"\
+"                         the formula per eliminated variable (default: 0)\n"\
+"    --bve-lit-bound=<n>  number of literals by which 'bve' may increase\n"\
+"                         the formula per eliminated variable (default: 0)\n"\
+"    --dep-scheme       relax the nesting restriction of 'qbce' and 'qble'\n"\
+"                         by the standard dependency scheme\n"\
+"    --dedup            drop duplicate clauses while parsing\n"\
+"    --compact-vars[=renumber]  number variables densely while parsing;\n"\
+"                         the formula is printed with the original IDs\n"\
+"                         unless 'renumber' is given\n"\
+"    --reorder          relabel variables and lay out clauses in breadth-\n"\
+"                         first order after parsing for better locality;\n"\
+"                         the output is not affected\n"\
+"    --print-formula    print parsed (and simplified) formula to stdout\n"\
+"                         Note: if option '--simplify' is NOT given\n"\
+"                         then the original formula is printed as is\n"\
+"    --print-blocked[=bitmap]  print only the IDs of blocked clauses, i.e.\n"\
+"                         their positions in the input starting at 1, one\n"\
+"                         per line or as binary bitmap (see 'qbce-prepro.h')\n"\
+"    --output-threads=<n>  with '--print-formula', format clauses by <n>\n"\
+"                         threads concurrently (default: 1)\n"\
+"    --blocking-lits    with '--print-blocked', also print the literal each\n"\
+"                         clause is blocked on\n"\
+"    -v                 increase verbosity level incrementally (default: 0)\n"
+
+/* Options for processing several formulas and for limits, printed after
+   'USAGE' to keep each string within the length supported by C99. */
+#define USAGE_MODES \
+"    --batch            'input-formula' is a directory or a file listing one\n"\
+"                         formula per line; all formulas are preprocessed\n"\
+"                         and a table of statistics is printed to stdout\n"\
+"    --server=<path>    serve requests on Unix domain socket <path>: each\n"\
+"                         connection sends a formula, shuts down writing\n"\
+"                         and receives the simplified formula followed by\n"\
+"                         its statistics as comment lines, or a line\n"\
+"                         'c error: <message>' if the formula failed\n"\
+"    --jobs=<n>         number of QBCE worker threads in batch and server\n"\
+"                         mode\n"\
+"                         (default: number of online processors)\n"\
+"    --out-dir=<dir>    in batch mode, write simplified formulas to <dir>\n"\
+"    --mem-limit=<n>    limit memory to <n> MB: QBCE stops early and prints\n"\
+"                         the formula simplified so far if the limit is\n"\
+"                         approached (in batch mode: limit per formula)\n"\
+"    --external-mem=<dir>  keep clauses and occurrence lists in a temporary\n"\
+"                         file in <dir> mapped into memory, for formulas\n"\
+"                         larger than physical memory; implies '--reorder'\n"\
+"    --external-rss=<n> in external memory mode, drop mapped pages once\n"\
+"                         <n> MB of them were touched (default: 256)\n"\
+"    --total-mem-limit=<n>\n"\
+"                       in batch mode, limit memory of all formulas processed\n"\
+"                         at the same time to <n> MB\n"\
+"    --checkpoint=<f>   periodically save the progress of QBCE to file <f>\n"\
+"                         (only with the default pipeline)\n"\
+"    --checkpoint-interval=<n>\n"\
+"                       seconds between checkpoints (default: 300)\n"\
+"    --resume           continue QBCE from the checkpoint, if any, instead\n"\
+"                         of starting over\n"\
+"    --stats-json=<f>   write timing, counter and memory statistics as JSON\n"\
+"                         to file <f> (in batch mode: array of all formulas)\n"\
+"\n"
+
+/* -------------------- END: Helper macros -------------------- */
+
+/* Print error message. */
+static void
+print_abort_err(char *msg, ...) {
+    va_list list;
+    assert (msg != NULL);
+    fprintf(stderr, "qbce-prepro: ");
+    va_start (list, msg);
+    vfprintf(stderr, msg, list);
+    va_end (list);
+    fflush(stderr);
+    abort();
+}
+
+/* -------------------- START: COMMAND LINE PARSING -------------------- */
+static void
+set_default_options(QBCEPrepro *qr) {
+    qr->options.in_filename = 0;
+    qr->options.in = stdin;
+    qr->options.print_usage = 0;
+    qr->options.checkpoint_interval = 300;
+    qr->options.external_rss = 256;
+}
+
+static int
+isnumstr(char *str) {
+    /* Empty string is not considered as number-string. */
+    if (!*str)
+        return 0;
+    char *p;
+    for (p = str; *p; p++) {
+        if (!isdigit (*p))
+            return 0;
+    }
+    return 1;
+}
+
+/* Parse command line arguments to set options accordingly. Run the program
+   with '-h' or '--help' to print usage information. */
+static void
+parse_cmd_line_options(QBCEPrepro *qr, int argc, char **argv) {
+    char *result;
+    int opt_cnt;
+    for (opt_cnt = 1; opt_cnt < argc; opt_cnt++) {
+        char *opt_str = argv[opt_cnt];
+
+        if (!strcmp(opt_str, "-h") || !strcmp(opt_str, "--help")) {
+            qr->options.print_usage = 1;
+        } else if (!strcmp(opt_str, "--simplify")) {
+            qr->options.simplify = 1;
+        } else if (!strncmp(opt_str, "--print-formula", strlen("--print-formula"))) {
+            qr->options.print_formula = 1;
+        } else if (!strncmp(opt_str, "--output-threads=",
+                            strlen("--output-threads="))) {
+            qr->options.output_threads =
+                atoi(opt_str + strlen("--output-threads="));
+            if (qr->options.output_threads == 0)
+                print_abort_err("Expecting positive number of threads!\n\n");
+        } else if (!strcmp(opt_str, "--print-blocked")) {
+            qr->options.print_blocked = 1;
+        } else if (!strcmp(opt_str, "--print-blocked=bitmap")) {
+            qr->options.print_blocked = 2;
+        } else if (!strcmp(opt_str, "--blocking-lits")) {
+            qr->options.blocking_lits = 1;
+        } else if (!strcmp(opt_str, "-v")) {
+            qr->options.verbosity++;
+        } else if (!strcmp(opt_str, "--batch")) {
+            qr->options.batch = 1;
+        } else if (!strncmp(opt_str, "--server=", strlen("--server="))) {
+            qr->options.server = opt_str + strlen("--server=");
+        } else if (!strncmp(opt_str, "--jobs=", strlen("--jobs="))) {
+            qr->options.jobs = atoi(opt_str + strlen("--jobs="));
+            if (qr->options.jobs == 0)
+                print_abort_err("Expecting positive number of jobs!\n\n");
+        } else if (!strncmp(opt_str, "--out-dir=", strlen("--out-dir="))) {
+            qr->options.out_dir = opt_str + strlen("--out-dir=");
+        } else if (!strncmp(opt_str, "--external-mem=",
+                            strlen("--external-mem="))) {
+            qr->options.external_mem = opt_str + strlen("--external-mem=");
+            /* Lay out clauses in the order QBCE visits them. */
+            qr->options.reorder = 1;
+        } else if (!strncmp(opt_str, "--external-rss=",
+                            strlen("--external-rss="))) {
+            qr->options.external_rss =
+                atoi(opt_str + strlen("--external-rss="));
+            if (qr->options.external_rss == 0)
+                print_abort_err("Expecting positive resident set limit!\n\n");
+        } else if (!strncmp(opt_str, "--mem-limit=", strlen("--mem-limit="))) {
+            qr->options.mem_limit = atoi(opt_str + strlen("--mem-limit="));
+            if (qr->options.mem_limit == 0)
+                print_abort_err("Expecting positive memory limit!\n\n");
+        } else if (!strcmp(opt_str, "--mem-limit") && opt_cnt + 1 < argc) {
+            qr->options.mem_limit = atoi(argv[++opt_cnt]);
+            if (qr->options.mem_limit == 0)
+                print_abort_err("Expecting positive memory limit!\n\n");
+        } else if (!strncmp(opt_str, "--total-mem-limit=",
+                            strlen("--total-mem-limit="))) {
+            qr->options.total_mem_limit =
+                atoi(opt_str + strlen("--total-mem-limit="));
+            if (qr->options.total_mem_limit == 0)
+                print_abort_err("Expecting positive memory limit!\n\n");
+        } else if (!strncmp(opt_str, "--pipeline=", strlen("--pipeline="))) {
+            qr->options.pipeline = opt_str + strlen("--pipeline=");
+            if (!qbce_set_pipeline(qr, qr->options.pipeline))
+                print_abort_err("invalid pipeline '%s'!\n\n",
+                                qr->options.pipeline);
+        } else if (!strcmp(opt_str, "--compact-vars")) {
+            qr->options.compact_vars = 1;
+        } else if (!strcmp(opt_str, "--compact-vars=renumber")) {
+            qr->options.compact_vars = 2;
+        } else if (!strncmp(opt_str, "--checkpoint=", strlen("--checkpoint="))) {
+            qr->options.checkpoint = opt_str + strlen("--checkpoint=");
+        } else if (!strncmp(opt_str, "--checkpoint-interval=",
+                            strlen("--checkpoint-interval="))) {
+            qr->options.checkpoint_interval =
+                atoi(opt_str + strlen("--checkpoint-interval="));
+            if (qr->options.checkpoint_interval == 0)
+                print_abort_err("Expecting positive checkpoint interval!\n\n");
+        } else if (!strcmp(opt_str, "--resume")) {
+            qr->options.resume = 1;
+        } else if (!strcmp(opt_str, "--reorder")) {
+            qr->options.reorder = 1;
+        } else if (!strcmp(opt_str, "--dedup")) {
+            qr->options.dedup = 1;
+        } else if (!strcmp(opt_str, "--dep-scheme")) {
+            qr->options.dep_scheme = 1;
+        } else if (!strcmp(opt_str, "--ala")) {
+            qr->options.ala = 1;
+        } else if (!strncmp(opt_str, "--ext-effort=", strlen("--ext-effort="))) {
+            qr->options.ext_effort = atoi(opt_str + strlen("--ext-effort="));
+            if (qr->options.ext_effort == 0)
+                print_abort_err("Expecting positive effort limit!\n\n");
+        } else if (!strncmp(opt_str, "--bve-clause-bound=",
+                            strlen("--bve-clause-bound="))) {
+            qr->options.bve_clause_bound =
+                atoi(opt_str + strlen("--bve-clause-bound="));
+        } else if (!strncmp(opt_str, "--bve-lit-bound=",
+                            strlen("--bve-lit-bound="))) {
+            qr->options.bve_lit_bound =
+                atoi(opt_str + strlen("--bve-lit-bound="));
+        } else if (!strncmp(opt_str, "--stats-json=", strlen("--stats-json="))) {
+            qr->options.stats_json = opt_str + strlen("--stats-json=");
+        } else if (!strcmp(opt_str, "--stats-json") && opt_cnt + 1 < argc) {
+            qr->options.stats_json = argv[++opt_cnt];
+        } else if (isnumstr(opt_str)) {
+            qr->options.max_time = atoi(opt_str);
+            if (qr->options.max_time == 0) {
+                result = "Expecting non-zero value for max-time";
+                print_abort_err("%s!\n\n", result);
+            }
+        } else if (!qr->options.in_filename) {
+            qr->options.in_filename = opt_str;
+        } else {
+            print_abort_err("unknown option '%s'!\n\n", opt_str);
+        }
+    }
+
+    /* Checkpoints only capture QBCE on the parsed formula. */
+    if (qr->options.resume && !qr->options.checkpoint)
+        print_abort_err("option '--resume' requires '--checkpoint'!\n\n");
+    if (qr->options.checkpoint && (qr->options.batch ||
+                                   qr->pipeline_len > 1 ||
+                                   (qr->pipeline_len &&
+                                    qr->pipeline[0] != STAGE_QBCE)))
+        print_abort_err("checkpoints require the default pipeline and no "
+                        "batch mode!\n\n");
+
+    if (qr->options.print_blocked && (qr->options.print_formula ||
+                                      qr->options.batch))
+        print_abort_err("option '--print-blocked' excludes '--print-formula' "
+                        "and batch mode!\n\n");
+    if (qr->options.blocking_lits && !qr->options.print_blocked)
+        print_abort_err("option '--blocking-lits' requires "
+                        "'--print-blocked'!\n\n");
+
+    if (qr->options.external_mem && (qr->options.batch ||
+                                     qr->options.server))
+        print_abort_err("external memory mode requires a single input "
+                        "formula!\n\n");
+    /* Output threads would fault in mapped pages without bounding the
+       resident set. */
+    if (qr->options.external_mem && qr->options.output_threads > 1)
+        print_abort_err("external memory mode requires serial output!\n\n");
+
+    if (qr->options.server && (qr->options.batch || qr->options.checkpoint ||
+                               qr->options.in_filename))
+        print_abort_err("server mode takes no input file, batch mode or "
+                        "checkpoints!\n\n");
+
+    /* Check input file. In batch mode, it is opened by 'run_batch'. In
+       server mode, formulas are read from the socket. */
+    if (qr->options.batch || qr->options.server) {
+        if (qr->options.batch && !qr->options.in_filename)
+            print_abort_err("batch mode requires a directory or file list!\n\n");
+        if (!qr->options.jobs) {
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            qr->options.jobs = cpus > 0 ? cpus : 1;
+        }
+    } else if (qr->options.in_filename) {
+        DIR *dir;
+        if ((dir = opendir(qr->options.in_filename)) != NULL) {
+            closedir(dir);
+            print_abort_err("input file '%s' is a directory!\n\n",
+                            qr->options.in_filename);
+        }
+        FILE *input_file = fopen(qr->options.in_filename, "r");
+        if (!input_file) {
+            print_abort_err("could not open input file '%s'!\n\n",
+                            qr->options.in_filename);
+        } else
+            qr->options.in = input_file;
+    }
+}
+
+/* -------------------- END: COMMAND LINE PARSING -------------------- */
+
+/* -------------------- START: HELPER FUNCTIONS -------------------- */
+
+/* Set signal handler. */
+static void
+sig_handler(int sig) {
+    fprintf(stderr, "\n\n SIG RECEIVED\n\n");
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/* Set signal handler. */
+static void
+sigalrm_handler(int sig) {
+    fprintf(stderr, "\n\n SIGALRM RECEIVED\n\n");
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/* Set signal handler. */
+static void
+set_signal_handlers(void) {
+    signal(SIGINT, sig_handler);
+    signal(SIGTERM, sig_handler);
+    signal(SIGALRM, sigalrm_handler);
+    signal(SIGXCPU, sigalrm_handler);
+}
+
+static void
+print_usage() {
+    fprintf(stdout, USAGE);
+    fprintf(stdout, USAGE_MODES);
+}
+
+/* Close input file and free allocated memory. */
+static void
+cleanup(QBCEPrepro *qr) {
+    if (qr->options.in_filename && !qr->options.batch)
+        fclose(qr->options.in);
+    qbce_delete(qr);
+}
+
+/* Get process time. Can be used for performance statistics. */
+static double
+time_stamp() {
+    double result = 0;
+    struct rusage usage;
+
+    if (!getrusage(RUSAGE_SELF, &usage)) {
+        result += usage.ru_utime.tv_sec + 1e-6 * usage.ru_utime.tv_usec;
+        result += usage.ru_stime.tv_sec + 1e-6 * usage.ru_stime.tv_usec;
+    }
+
+    return result;
+}
+
+/* -------------------- END: HELPER FUNCTIONS -------------------- */
+
+int
+main(int argc, char **argv) {
+    double start_time = time_stamp();
+    int result = 0;
+    /* Initialize QBCEPrepro object, including its memory manager. */
+    QBCEPrepro *qr = qbce_create();
+    qr->start_time = start_time;
+    set_default_options(qr);
+
+    parse_cmd_line_options(qr, argc, argv);
+
+    set_signal_handlers();
+
+    if (qr->options.print_usage) {
+        print_usage();
+        cleanup(qr);
+        return result;
+    }
+
+    if (qr->options.max_time) {
+        fprintf(stderr, "Setting run time limit of %d seconds\n",
+                qr->options.max_time);
+        alarm(qr->options.max_time);
+    }
+
+    if (qr->options.server) {
+        run_server(qr->options.server, qr);
+        cleanup(qr);
+        return result;
+    }
+
+    if (qr->options.batch) {
+        if (run_batch(qr->options.in_filename, qr->options.out_dir,
+                      qr->options.stats_json, qr->options.jobs,
+                      qr->options.mem_limit, qr->options.total_mem_limit,
+                      qr->options.pipeline, qr->options.verbosity))
+            result = 1;
+        cleanup(qr);
+        return result;
+    }
+
+    if (qr->options.external_mem)
+        mm_set_external(qr->mm, qr->options.external_mem,
+                        qr->options.external_rss);
+    if (qr->options.mem_limit)
+        mm_set_mem_limit(qr->mm, qr->options.mem_limit);
+
+    /* Parse QDIMACS formula and simplify, if appropriate command line options
+       are given. */
+    parse(qr, qr->options.in);
+    ABORT_APP (qr->declared_num_clauses > qr->cur_clause_id,
+               "declared number of clauses exceeds actual number of clauses!");
+
+    if (qr->options.resume) {
+        int resumed = qbce_read_checkpoint(qr, qr->options.checkpoint);
+        if (resumed < 0)
+            fprintf(stderr, "Checkpoint '%s' does not match the formula, "
+                    "starting over\n", qr->options.checkpoint);
+        else if (resumed && qr->options.verbosity >= 1)
+            fprintf(stderr, "resumed from checkpoint with %u blocked "
+                    "clauses\n", qr->cnt_blocked_clauses);
+    }
+
+    qbce_simplify(qr);
+    if (qr->mem_limit_reached)
+        fprintf(stderr, "Memory limit of %u MB approached, QBCE stopped early\n",
+                qr->options.mem_limit);
+
+    /* Print formula to stdout. */
+    if (qr->options.print_formula)
+        qbce_print_formula(qr, stdout);
+    else if (qr->options.print_blocked)
+        qbce_print_blocked(qr, stdout, qr->options.print_blocked == 2,
+                           qr->options.blocking_lits);
+
+    if (qr->options.verbosity >= 1) {
+        /* Print statistics. */
+        fprintf(stderr, "\nDONE, printing statistics:\n");
+        if (!qr->options.max_time)
+            fprintf(stderr, "  time limit: not set\n");
+        else
+            fprintf(stderr, "  time limit: %d\n", qr->options.max_time);
+        fprintf(stderr, "  simplification enabled: %s\n",
+                qr->options.simplify ? "yes" : "no");
+        fprintf(stderr, "  printing formula: %s\n",
+                qr->options.print_formula ? "yes" : "no");
+        fprintf(stderr, "  QBCE: %d blocked clauses of total %d clauses ( %f %% of initial CNF)\n",
+                qr->cnt_blocked_clauses, qr->declared_num_clauses, qr->declared_num_clauses ?
+                                                                   ((qr->cnt_blocked_clauses /
+                                                                     (float) qr->declared_num_clauses) * 100) : 0);
+        if (qr->options.dedup)
+            fprintf(stderr, "  duplicate clauses: %u\n",
+                    qr->stats.duplicate_clauses);
+        fprintf(stderr, "  QBCE rounds: %u\n",
+                (unsigned int) COUNT_STACK (qr->stats.rounds));
+        unsigned int i;
+        for (i = 0; i < qr->pipeline_len; i++) {
+            StageStats *ss = qr->stats.stages + qr->pipeline[i];
+            fprintf(stderr, "  stage %s: %u runs, %llu changes, %f s\n",
+                    qbce_stage_name(qr->pipeline[i]), ss->runs, ss->changes,
+                    ss->time.wall);
+        }
+        if (qr->empty_clause)
+            fprintf(stderr, "  empty clause derived, formula is false\n");
+        fprintf(stderr, "  run time: %f\n", time_stamp() - qr->start_time);
+    }
+
+    if (qr->options.stats_json) {
+        FILE *out = fopen(qr->options.stats_json, "w");
+        if (!out)
+            print_abort_err("could not open statistics file '%s'!\n\n",
+                            qr->options.stats_json);
+        qbce_print_stats_json(qr, out, qr->options.in_filename ?
+                              qr->options.in_filename : "<stdin>");
+        fclose(out);
+    }
+
+    /* Clean up, free memory and exit. */
+    cleanup(qr);
+
+    return result;
+}
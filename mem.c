@@ -18,22 +18,22 @@
  along with qbce-prepro.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <stddef.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include "mem.h"
+#include "error.h"
 
 #define ABORT_MEM(cond,msg)					\
   do {									\
     if (cond)								\
-      {									\
-        fprintf (stderr, "[mem_man] %s at line %d: %s\n", __func__,	\
-		 __LINE__,msg);						\
-	fflush (stderr);						\
-        abort ();							\
-      }									\
+      qbce_error ("mem_man", __func__, __LINE__, msg);			\
   } while (0)
 
 MemMan *
@@ -46,73 +46,572 @@ mm_create ()
 }
 
 
+static void publish (MemMan * mm, int force);
+static void *ext_alloc (MemMan * mm, size_t size, int zero);
+static void *ext_resize (MemMan * mm, void *ptr, size_t old_size,
+                         size_t new_size, int zero);
+static void ext_free (MemMan * mm, void *ptr, size_t size);
+
 void
 mm_delete (MemMan * mm)
 {
   ABORT_MEM (!mm, "null pointer encountered!");
   assert (mm->cur_allocated == 0);
+  if (mm->parent)
+    publish (mm, 1);
+  if (mm->ext_base)
+    munmap (mm->ext_base, MM_EXT_RESERVE);
+  void *slab, *next;
+  for (slab = mm->slabs; slab; slab = next)
+    {
+      next = *(void **) slab;
+      free (slab);
+    }
   free (mm);
 }
 
 
-void *
-mm_malloc (MemMan * mm, size_t size)
+/* Memory managers used by different threads, like one per formula in batch
+   mode, can be attached to a common parent to account for their total
+   usage and to enforce a limit on it. Each thread allocates from its own
+   manager without synchronization and publishes its usage to the parent
+   by atomic operations only after it changed by 'MM_PUBLISH_QUANTUM'
+   bytes. Hence the total usage and peak of the parent are exact up to
+   that amount per attached manager. The parent itself must not allocate
+   while managers are attached to it. */
+#define MM_PUBLISH_QUANTUM (256 * 1024)
+
+void
+mm_set_parent (MemMan * mm, MemMan * parent)
+{
+  ABORT_MEM (mm->cur_allocated, "memory already allocated!");
+  mm->parent = parent;
+}
+
+
+/* Add the usage changed since the last call to the parent, if it changed
+   by at least 'MM_PUBLISH_QUANTUM' bytes or 'force' is set. */
+static void
+publish (MemMan * mm, int force)
+{
+  MemMan *p = mm->parent;
+  size_t cur = mm->cur_allocated, pub = mm->published, total;
+  if (cur >= pub)
+    {
+      if (!force && cur - pub < MM_PUBLISH_QUANTUM)
+        return;
+      total = __atomic_add_fetch (&p->cur_allocated, cur - pub,
+                                  __ATOMIC_RELAXED);
+    }
+  else
+    {
+      if (!force && pub - cur < MM_PUBLISH_QUANTUM)
+        return;
+      total = __atomic_sub_fetch (&p->cur_allocated, pub - cur,
+                                  __ATOMIC_RELAXED);
+    }
+  mm->published = cur;
+  size_t max = __atomic_load_n (&p->max_allocated, __ATOMIC_RELAXED);
+  while (total > max
+         && !__atomic_compare_exchange_n (&p->max_allocated, &max, total, 1,
+                                          __ATOMIC_RELAXED,
+                                          __ATOMIC_RELAXED))
+    ;
+}
+
+
+/* Total usage of the parent including the unpublished usage of 'mm'. */
+static size_t
+parent_allocated (MemMan * mm)
+{
+  size_t total = __atomic_load_n (&mm->parent->cur_allocated,
+                                  __ATOMIC_RELAXED);
+  if (mm->cur_allocated > mm->published)
+    total += mm->cur_allocated - mm->published;
+  return total;
+}
+
+
+/* Allocations of at least 'MM_MMAP_THRESHOLD' bytes, like the table of
+   variables, are mapped directly and backed by transparent huge pages to
+   reduce TLB misses. Whether a block is mapped is derived from its size,
+   hence blocks must always be released with the size they were allocated
+   with. Mapped memory is zeroed by the kernel. */
+#define MM_MMAP_THRESHOLD (2 * 1024 * 1024)
+
+/* The limit is considered approached if less than 'MM_LIMIT_RESERVE_PERCENT'
+   percent of it are left. */
+#define MM_LIMIT_RESERVE_PERCENT 10
+
+static void *
+map_pages (size_t size)
+{
+  void *r = mmap (0, size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  ABORT_MEM (r == MAP_FAILED, "could not allocate memory!");
+#ifdef MADV_HUGEPAGE
+  madvise (r, size, MADV_HUGEPAGE);
+#endif
+  return r;
+}
+
+/* Return nonzero if allocating 'size' additional bytes exceeds the limit
+   of 'mm' or of its parent. */
+static int
+exceeds_limit (MemMan * mm, size_t size)
 {
   /* Mem-limit is given in MB. */
   if (mm->limit && mm->limit < (mm->cur_allocated + size) / 1024 / 1024)
+    return 1;
+  return mm->parent && mm->parent->limit
+    && mm->parent->limit < (parent_allocated (mm) + size) / 1024 / 1024;
+}
+
+static void
+check_limit (MemMan * mm, size_t size)
+{
+  if (exceeds_limit (mm, size))
     {
+      int own = mm->limit
+        && mm->limit < (mm->cur_allocated + size) / 1024 / 1024;
       fprintf (stderr,
-               "Attempted to allocate total %f MB (limit = %lu MB)\n",
-               ((unsigned long) (mm->cur_allocated +
+               "Attempted to allocate total %f MB%s (limit = %lu MB)\n",
+               ((unsigned long) ((own ? mm->cur_allocated :
+                                  parent_allocated (mm)) +
                                  size)) / 1024 / (float) 1024,
-               (unsigned long) mm->limit);
+               own ? "" : " in all threads",
+               (unsigned long) (own ? mm->limit : mm->parent->limit));
       ABORT_MEM (1, "mem-limit exceeded!");
     }
-  void *r = malloc (size);
-  ABORT_MEM (!r, "could not allocate memory!");
-  memset (r, 0, size);
-  mm->cur_allocated += size;
+}
+
+static void
+count_allocated (MemMan * mm, size_t old_size, size_t new_size)
+{
+  mm->cur_allocated -= old_size;
+  mm->cur_allocated += new_size;
   if (mm->cur_allocated > mm->max_allocated)
     mm->max_allocated = mm->cur_allocated;
+  if (mm->parent)
+    publish (mm, 0);
+}
+
+void *
+mm_malloc (MemMan * mm, size_t size)
+{
+  check_limit (mm, size);
+  void *r;
+  if (mm->ext_base)
+    r = ext_alloc (mm, size, 1);
+  else if (size >= MM_MMAP_THRESHOLD)
+    r = map_pages (size);
+  else
+    {
+      r = malloc (size);
+      ABORT_MEM (!r, "could not allocate memory!");
+      memset (r, 0, size);
+    }
+  count_allocated (mm, 0, size);
   return r;
 }
 
 
+/* Like 'mm_malloc' but return null instead of aborting if the limit would
+   be exceeded. */
 void *
-mm_realloc (MemMan * mm, void *ptr, size_t old_size, size_t new_size)
+mm_try_malloc (MemMan * mm, size_t size)
+{
+  if (exceeds_limit (mm, size))
+    return 0;
+  return mm_malloc (mm, size);
+}
+
+
+/* Resize a block not taken from the pool. If 'zero' is set, then the added
+   bytes are zeroed. */
+static void *
+resize (MemMan * mm, void *ptr, size_t old_size, size_t new_size, int zero)
 {
-  ptr = realloc (ptr, new_size);
-  ABORT_MEM (!ptr, "could not allocate memory!");
   if (new_size > old_size)
-    memset (((char *) ptr) + old_size, 0, new_size - old_size);
-  mm->cur_allocated -= old_size;
-  mm->cur_allocated += new_size;
-  if (mm->cur_allocated > mm->max_allocated)
-    mm->max_allocated = mm->cur_allocated;
+    check_limit (mm, new_size - old_size);
+  if (mm->ext_base)
+    ptr = ext_resize (mm, ptr, old_size, new_size, zero);
+  else if (old_size >= MM_MMAP_THRESHOLD && new_size >= MM_MMAP_THRESHOLD)
+    {
+      ptr = mremap (ptr, old_size, new_size, MREMAP_MAYMOVE);
+      ABORT_MEM (ptr == MAP_FAILED, "could not allocate memory!");
+#ifdef MADV_HUGEPAGE
+      madvise (ptr, new_size, MADV_HUGEPAGE);
+#endif
+    }
+  else if (new_size >= MM_MMAP_THRESHOLD)
+    {
+      void *r = map_pages (new_size);
+      if (ptr)
+        {
+          memcpy (r, ptr, old_size);
+          free (ptr);
+        }
+      ptr = r;
+    }
+  else if (old_size >= MM_MMAP_THRESHOLD)
+    {
+      void *r = malloc (new_size);
+      ABORT_MEM (!r, "could not allocate memory!");
+      memcpy (r, ptr, new_size);
+      munmap (ptr, old_size);
+      ptr = r;
+    }
+  else
+    {
+      ptr = realloc (ptr, new_size);
+      ABORT_MEM (!ptr, "could not allocate memory!");
+      if (zero && new_size > old_size)
+        memset (((char *) ptr) + old_size, 0, new_size - old_size);
+    }
+  count_allocated (mm, old_size, new_size);
   return ptr;
 }
 
 
+void *
+mm_realloc (MemMan * mm, void *ptr, size_t old_size, size_t new_size)
+{
+  return resize (mm, ptr, old_size, new_size, 1);
+}
+
+
+/* Stack blocks up to 'MM_POOL_MAX_SIZE' bytes, like the occurrence lists
+   of the variables, are cut from slabs of 'MM_SLAB_SIZE' bytes. A block
+   takes the smallest power-of-two size class that fits, and blocks
+   released or outgrown by a stack are kept in a free list of their class
+   for reuse. This avoids a call to 'realloc' for every doubling of
+   millions of short stacks. Slabs are only released by 'mm_delete'. The
+   memory accounted for a block is the size of its class. */
+#define MM_SLAB_SIZE (64 * 1024)
+
+/* Slab header holding the link to the next slab, padded for alignment. */
+#define MM_SLAB_HEADER 16
+
+static unsigned int
+size_class (size_t size)
+{
+  unsigned int c = 0;
+  while (((size_t) MM_POOL_MIN_SIZE << c) < size)
+    c++;
+  return c;
+}
+
+#define CLASS_SIZE(c) ((size_t) MM_POOL_MIN_SIZE << (c))
+
+static void *
+pool_alloc (MemMan * mm, unsigned int c)
+{
+  size_t size = CLASS_SIZE (c);
+  check_limit (mm, size);
+  count_allocated (mm, 0, size);
+  void *r = mm->free_blocks[c];
+  if (r)
+    {
+      mm->free_blocks[c] = *(void **) r;
+      return r;
+    }
+  if (mm->slab_end - mm->slab_pos < (ptrdiff_t) size)
+    {
+      /* The rest of the current slab is left unused, which is less than
+         'MM_POOL_MAX_SIZE' bytes. */
+      char *slab = malloc (MM_SLAB_SIZE);
+      ABORT_MEM (!slab, "could not allocate memory!");
+      *(void **) slab = mm->slabs;
+      mm->slabs = slab;
+      mm->slab_pos = slab + MM_SLAB_HEADER;
+      mm->slab_end = slab + MM_SLAB_SIZE;
+    }
+  r = mm->slab_pos;
+  mm->slab_pos += size;
+  return r;
+}
+
+static void
+pool_free (MemMan * mm, void *ptr, unsigned int c)
+{
+  *(void **) ptr = mm->free_blocks[c];
+  mm->free_blocks[c] = ptr;
+  count_allocated (mm, CLASS_SIZE (c), 0);
+}
+
+
+/* Resize the block of a stack. Unlike 'mm_realloc', the added bytes are not
+   zeroed since stacks never read above their top. Blocks passed here must
+   only be released by 'mm_stack_free'. */
+void *
+mm_stack_realloc (MemMan * mm, void *ptr, size_t old_size, size_t new_size)
+{
+  if (!ptr)
+    old_size = 0;
+  if (mm->ext_base
+      || (old_size > MM_POOL_MAX_SIZE && new_size > MM_POOL_MAX_SIZE))
+    return resize (mm, ptr, old_size, new_size, 0);
+  if (old_size <= MM_POOL_MAX_SIZE && new_size <= MM_POOL_MAX_SIZE)
+    {
+      unsigned int old_class = size_class (old_size);
+      unsigned int new_class = size_class (new_size);
+      if (ptr && old_class == new_class)
+        return ptr;
+      void *r = pool_alloc (mm, new_class);
+      if (ptr)
+        {
+          memcpy (r, ptr, old_size < new_size ? old_size : new_size);
+          pool_free (mm, ptr, old_class);
+        }
+      return r;
+    }
+  void *r;
+  if (new_size > MM_POOL_MAX_SIZE)
+    {
+      r = resize (mm, 0, 0, new_size, 0);
+      if (ptr)
+        {
+          memcpy (r, ptr, old_size);
+          pool_free (mm, ptr, size_class (old_size));
+        }
+    }
+  else
+    {
+      r = pool_alloc (mm, size_class (new_size));
+      memcpy (r, ptr, new_size);
+      mm_free (mm, ptr, old_size);
+    }
+  return r;
+}
+
+
+void
+mm_stack_free (MemMan * mm, void *ptr, size_t size)
+{
+  if (!ptr)
+    return;
+  if (size <= MM_POOL_MAX_SIZE && !mm->ext_base)
+    pool_free (mm, ptr, size_class (size));
+  else
+    mm_free (mm, ptr, size);
+}
+
+
 void
 mm_free (MemMan * mm, void *ptr, size_t size)
 {
   ABORT_MEM (!mm, "null pointer encountered!");
-  free (ptr);
-  mm->cur_allocated -= size;
+  if (mm->ext_base)
+    ext_free (mm, ptr, size);
+  else if (size >= MM_MMAP_THRESHOLD)
+    munmap (ptr, size);
+  else
+    free (ptr);
+  count_allocated (mm, size, 0);
+}
+
+
+/* External memory. The file is unlinked right after it was created, such
+   that it is removed when the program exits, and is mapped as a whole,
+   reserving 'MM_EXT_RESERVE' bytes of address space. The file is sparse:
+   disk space and page cache are only used for pages actually written to.
+   A block of up to 'MM_POOL_MAX_SIZE' bytes takes the smallest multiple of
+   8 bytes that fits, a larger one the smallest power of two, which wastes
+   address space rather than memory as pages not touched are never
+   backed. Blocks are cut from the file in the order of allocation, hence
+   the clauses of a parsed formula are laid out sequentially. Released
+   blocks are kept in a free list of their class for reuse, where blocks
+   of whole pages are punched out of the file. */
+
+static unsigned int
+ext_class (size_t size, size_t * class_size)
+{
+  if (size <= MM_POOL_MAX_SIZE)
+    {
+      size_t n = size ? (size + 7) / 8 : 1;
+      *class_size = 8 * n;
+      return n - 1;
+    }
+  unsigned int shift = MM_POOL_MAX_SHIFT + 1;
+  while (((size_t) 1 << shift) < size)
+    shift++;
+  *class_size = (size_t) 1 << shift;
+  return MM_POOL_MAX_SIZE / 8 + shift - MM_POOL_MAX_SHIFT - 1;
+}
+
+static void *
+ext_alloc (MemMan * mm, size_t size, int zero)
+{
+  size_t class_size, page = sysconf (_SC_PAGESIZE);
+  unsigned int c = ext_class (size, &class_size);
+  void *r = mm->ext_free_blocks[c];
+  if (r)
+    {
+      mm->ext_free_blocks[c] = *(void **) r;
+      /* Punched out pages read as zeros, except for the link. */
+      if (zero && class_size < page)
+        memset (r, 0, size);
+      else if (zero)
+        *(void **) r = 0;
+    }
+  else
+    {
+      size_t align = class_size < page ? 8 : page;
+      size_t pos = (mm->ext_pos + align - 1) & ~(align - 1);
+      ABORT_MEM (pos + class_size > MM_EXT_RESERVE,
+                 "external memory file exhausted!");
+      r = mm->ext_base + pos;
+      mm->ext_pos = pos + class_size;
+    }
+  mm_external_touch (mm, r, size);
+  return r;
+}
+
+static void
+ext_free (MemMan * mm, void *ptr, size_t size)
+{
+  size_t class_size;
+  unsigned int c = ext_class (size, &class_size);
+  /* Zero the block by hand if the file system cannot punch holes. */
+  if (class_size >= (size_t) sysconf (_SC_PAGESIZE)
+      && madvise (ptr, class_size, MADV_REMOVE))
+    memset (ptr, 0, class_size);
+  *(void **) ptr = mm->ext_free_blocks[c];
+  mm->ext_free_blocks[c] = ptr;
+  mm_external_touch (mm, ptr, sizeof (void *));
+}
+
+static void *
+ext_resize (MemMan * mm, void *ptr, size_t old_size, size_t new_size,
+            int zero)
+{
+  size_t old_class_size, new_class_size;
+  if (ptr && ext_class (old_size, &old_class_size)
+      == ext_class (new_size, &new_class_size))
+    {
+      if (zero && new_size > old_size)
+        memset ((char *) ptr + old_size, 0, new_size - old_size);
+      return ptr;
+    }
+  void *r = ext_alloc (mm, new_size, zero);
+  if (ptr)
+    {
+      memcpy (r, ptr, old_size < new_size ? old_size : new_size);
+      mm_external_touch (mm, ptr, old_size);
+      ext_free (mm, ptr, old_size);
+    }
+  return r;
+}
+
+void
+mm_set_external (MemMan * mm, const char *dir, size_t rss_limit)
+{
+  ABORT_MEM (mm->cur_allocated || mm->ext_base, "memory already allocated!");
+  char *path = malloc (strlen (dir) + sizeof ("/qbce-prepro-XXXXXX"));
+  ABORT_MEM (!path, "could not allocate memory!");
+  sprintf (path, "%s/qbce-prepro-XXXXXX", dir);
+  int fd = mkstemp (path);
+  ABORT_MEM (fd < 0, "could not create external memory file!");
+  unlink (path);
+  free (path);
+  ABORT_MEM (ftruncate (fd, MM_EXT_RESERVE),
+             "could not create external memory file!");
+  void *base = mmap (0, MM_EXT_RESERVE, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_NORESERVE, fd, 0);
+  close (fd);
+  ABORT_MEM (base == MAP_FAILED, "could not map external memory file!");
+  mm->ext_base = base;
+  mm->ext_page_size = sysconf (_SC_PAGESIZE);
+  mm->ext_rss_pages = rss_limit * 1024 * 1024 / mm->ext_page_size;
+  mm->ext_lo_page = (size_t) -1;
+  mm->ext_last_page = (size_t) -1;
+}
+
+
+/* Pages of the mapping are resident only if touched since the pages were
+   last dropped, and all of them lie in the range touched since then.
+   Hence they are dropped once both the pages counted and the range exceed
+   the limit, and only that range is dropped, which is the part just passed
+   in a pass over the clauses. Dropped pages stay in the page cache, from
+   where they are written back and evicted by the kernel as needed. */
+void
+mm_external_touch (MemMan * mm, const void *ptr, size_t bytes)
+{
+  const char *p = ptr;
+  if (p < mm->ext_base || p >= mm->ext_base + mm->ext_pos || !bytes)
+    return;
+  size_t lo = (p - mm->ext_base) / mm->ext_page_size;
+  size_t hi = (p - mm->ext_base + bytes - 1) / mm->ext_page_size;
+  mm->ext_touched += hi - lo + (lo != mm->ext_last_page);
+  mm->ext_last_page = hi;
+  if (lo < mm->ext_lo_page)
+    mm->ext_lo_page = lo;
+  if (hi > mm->ext_hi_page)
+    mm->ext_hi_page = hi;
+  if (mm->ext_touched <= mm->ext_rss_pages
+      || mm->ext_hi_page - mm->ext_lo_page < mm->ext_rss_pages)
+    return;
+  madvise (mm->ext_base + mm->ext_lo_page * mm->ext_page_size,
+           (mm->ext_hi_page - mm->ext_lo_page + 1) * mm->ext_page_size,
+           MADV_DONTNEED);
+  mm->ext_touched = 0;
+  mm->ext_lo_page = (size_t) -1;
+  mm->ext_hi_page = 0;
+  mm->ext_last_page = (size_t) -1;
+}
+
+
+static int
+approaches (size_t limit, size_t allocated)
+{
+  return limit && allocated / 1024 / 1024 >=
+    limit - limit * MM_LIMIT_RESERVE_PERCENT / 100;
+}
+
+/* Return nonzero if a limit of 'mm' or of its parent is set and less than
+   'MM_LIMIT_RESERVE_PERCENT' percent of it are left. Used to stop optional
+   work before an allocation aborts. */
+int
+mm_limit_approached (MemMan * mm)
+{
+  return approaches (mm->limit, mm_cur_allocated (mm))
+    || (mm->parent && approaches (mm->parent->limit, parent_allocated (mm)));
 }
 
 
 size_t
 mm_max_allocated (MemMan * mm)
 {
-  return mm->max_allocated;
+  return __atomic_load_n (&mm->max_allocated, __ATOMIC_RELAXED);
 }
 
 
 size_t
 mm_cur_allocated (MemMan * mm)
 {
-  return mm->cur_allocated;
+  return __atomic_load_n (&mm->cur_allocated, __ATOMIC_RELAXED);
+}
+
+
+/* Start a new peak at the current usage, e.g. when the manager is reused
+   for another formula. */
+void
+mm_reset_max_allocated (MemMan * mm)
+{
+  __atomic_store_n (&mm->max_allocated, mm_cur_allocated (mm),
+                    __ATOMIC_RELAXED);
+}
+
+
+/* Stop accounting for the blocks still allocated, which must no longer be
+   referenced. After an error was recovered from (see 'error.h'), these are
+   temporary blocks of the operation that failed, which cannot be released
+   since they are unknown. */
+void
+mm_write_off (MemMan * mm)
+{
+  count_allocated (mm, mm->cur_allocated, 0);
 }
 
 
@@ -23,11 +23,53 @@
 
 #include <stddef.h>
 
+/* Blocks of stacks up to 'MM_POOL_MAX_SIZE' bytes are taken from size
+   classes of powers of two, starting at 'MM_POOL_MIN_SIZE' bytes. */
+#define MM_POOL_MIN_SHIFT 3
+#define MM_POOL_MAX_SHIFT 10
+#define MM_POOL_MIN_SIZE (1 << MM_POOL_MIN_SHIFT)
+#define MM_POOL_MAX_SIZE (1 << MM_POOL_MAX_SHIFT)
+#define MM_POOL_CLASSES (MM_POOL_MAX_SHIFT - MM_POOL_MIN_SHIFT + 1)
+
+/* Blocks of the external memory file (see 'mm_set_external') are taken
+   from size classes of multiples of 8 bytes up to 'MM_POOL_MAX_SIZE' bytes
+   and of powers of two up to 'MM_EXT_MAX_SHIFT' bits beyond. */
+#define MM_EXT_MAX_SHIFT 40
+#define MM_EXT_RESERVE ((size_t) 1 << MM_EXT_MAX_SHIFT)
+#define MM_EXT_CLASSES \
+  (MM_POOL_MAX_SIZE / 8 + MM_EXT_MAX_SHIFT - MM_POOL_MAX_SHIFT)
+
 struct MemMan
 {
   size_t cur_allocated;
   size_t max_allocated;
   size_t limit;
+  /* Free blocks per size class, linked through their first word. */
+  void *free_blocks[MM_POOL_CLASSES];
+  /* Unused part of the most recent slab, blocks are cut from it. */
+  char *slab_pos;
+  char *slab_end;
+  /* All slabs, linked through their header. */
+  void *slabs;
+  /* Memory manager shared by several threads which the usage of this one
+     is added to, see 'mm_set_parent'. */
+  struct MemMan *parent;
+  /* Part of 'cur_allocated' already added to the parent. */
+  size_t published;
+  /* Mapping of the external memory file if not null, the offset up to
+     which blocks have been cut from it, and free blocks per size class. */
+  char *ext_base;
+  size_t ext_pos;
+  void *ext_free_blocks[MM_EXT_CLASSES];
+  /* Pages of the mapping touched since they were last dropped from the
+     resident set, counted by 'mm_external_touch', and the range they lie
+     in, as page numbers. 'ext_last_page' is the page touched last. */
+  size_t ext_page_size;
+  size_t ext_rss_pages;
+  size_t ext_touched;
+  size_t ext_lo_page;
+  size_t ext_hi_page;
+  size_t ext_last_page;
 };
 
 typedef struct MemMan MemMan;
@@ -36,19 +78,58 @@ MemMan *mm_create ();
 
 void mm_delete (MemMan * mm);
 
+void mm_set_parent (MemMan * mm, MemMan * parent);
+
+/* External memory mode: all blocks of 'mm' are taken from a temporary file
+   in directory 'dir', which is mapped into memory. The kernel writes pages
+   of the file back to disk instead of requiring physical memory for them.
+   Mapped pages are dropped from the resident set whenever 'rss_limit' MB
+   of them have been touched since they were last dropped, as counted by
+   'MM_EXT_TOUCH'. This is a soft limit: only the clauses, occurrence lists
+   and indexes over them are counted, and the kernel may map pages next to
+   a page read along with it. Must be called before anything is
+   allocated. */
+void mm_set_external (MemMan * mm, const char *dir, size_t rss_limit);
+
+/* Count the pages of the 'bytes' bytes at 'ptr' in the mapping as touched,
+   and drop all pages touched since the last time from the resident set if
+   they reach the limit. Counting a page touched right before again is
+   avoided, such that a pass over consecutive blocks counts each page once.
+   Called after the memory was accessed. */
+void mm_external_touch (MemMan * mm, const void *ptr, size_t bytes);
+
+#define MM_EXT_TOUCH(mm, ptr, bytes)                                     \
+  do {                                                                  \
+    if ((mm)->ext_base)                                                 \
+      mm_external_touch (mm, ptr, bytes);                               \
+  } while (0)
+
 void *mm_malloc (MemMan * mm, size_t size);
 
+void *mm_try_malloc (MemMan * mm, size_t size);
+
 void *mm_realloc (MemMan * mm, void *ptr, size_t old_size,
                      size_t new_size);
 
 void mm_free (MemMan * mm, void *ptr, size_t size);
 
+void *mm_stack_realloc (MemMan * mm, void *ptr, size_t old_size,
+                        size_t new_size);
+
+void mm_stack_free (MemMan * mm, void *ptr, size_t size);
+
 size_t mm_max_allocated (MemMan * mm);
 
 size_t mm_cur_allocated (MemMan * mm);
 
+void mm_reset_max_allocated (MemMan * mm);
+
+void mm_write_off (MemMan * mm);
+
 void mm_set_mem_limit (MemMan * mm, size_t limit);
 
 size_t mm_get_mem_limit (MemMan * mm);
 
+int mm_limit_approached (MemMan * mm);
+
 #endif
@@ -20,6 +20,9 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include "parse.h"
 #include "error.h"
 
@@ -50,15 +53,17 @@ print_lits (QBCEPrepro * qr, FILE * out, LitID * lits, unsigned int num,
 /* Allocate table of variable IDs having fixed size. If the preamble of the
    QDIMACS file specifies a maximum variable ID which is smaller than the ID
    of a variable encountered in the formula, then the program aborts. */
-static void
+void
 set_up_var_table (QBCEPrepro * qr, int num)
 {
   assert (num >= 0);
   assert (!qr->pcnf.size_vars);
-  qr->pcnf.size_vars = num + 1;
   assert (!qr->pcnf.vars);
-  qr->pcnf.vars =
-    (Var *) mm_malloc (qr->mm, qr->pcnf.size_vars * sizeof (Var));
+  /* Set the size only after allocation succeeded, such that 'qbce_recover'
+     releases a consistent table. */
+  qr->pcnf.vars = (Var *) mm_malloc (qr->mm, ((size_t) num + 1) *
+                                     sizeof (Var));
+  qr->pcnf.size_vars = num + 1;
 }
 
 /* Allocate a new scope object and append it to the list of scopes. */
@@ -81,11 +86,15 @@ open_new_scope (QBCEPrepro * qr, QuantifierType scope_type)
    tautological clauses or multiple literals could be discarded. However, for
    simplicity, the program will abort.) */
 static void
-check_and_add_clause (QBCEPrepro * qr, Clause * clause)
+check_and_add_clause (QBCEPrepro * qr, Clause * clause, LitID * lits)
 {
-  /* Add parsed literals to allocated clause object 'clause'. */
+  /* Append clause to list of clauses first, such that it is released with
+     the formula if a check fails and the error is recovered from. */
+  LINK_LAST (qr->pcnf.clauses, clause, link);
+
+  /* Add literals 'lits' to allocated clause object 'clause'. */
   LitID *p, *e, *clause_lits_p = clause->lits;
-  for (p = qr->parsed_literals.start, e = qr->parsed_literals.top; p < e; p++)
+  for (p = lits, e = p + clause->num_lits; p < e; p++)
     {
       LitID lit = *p;
       VarID varid = LIT2VARID (lit);
@@ -122,7 +131,10 @@ check_and_add_clause (QBCEPrepro * qr, Clause * clause)
       assert (clause_lits_p < clause->lits + clause->num_lits);
       /* Add literal to clause object. */
       *clause_lits_p++ = *p;
-      /* Push clause object on stack of occurrences. */
+      /* Push clause object on stack of occurrences, unless parsing, where
+         all occurrences are collected by 'build_occurrences' afterwards. */
+      if (qr->parsing)
+        continue;
       if (LIT_NEG (lit))
         PUSH_STACK (qr->mm, var->neg_occ_clauses, clause);
       else
@@ -133,53 +145,325 @@ check_and_add_clause (QBCEPrepro * qr, Clause * clause)
      i.e. they appear in the clause as they are given in the QDIMACS file. */
 
   /* Unmark variables. */
-  for (p = qr->parsed_literals.start, e = qr->parsed_literals.top; p < e; p++)
+  for (p = lits, e = p + clause->num_lits; p < e; p++)
     VAR_UNMARK (LIT2VARPTR (qr->pcnf.vars, *p));
-
-  /* Append clause to list of clauses. */
-  LINK_LAST (qr->pcnf.clauses, clause, link);
 }
 
-/* Check and add a parsed clause to the PCNF data structures. */
-static void
-import_parsed_clause (QBCEPrepro * qr)
+/* Allocate a new clause object for the 'num_lits' literals in 'lits', check
+   it and add it to the PCNF data structures. Non-static since clauses may
+   also be added after parsing (see 'qbce_add_clause'). NOTE: the marks of all
+   variables in 'lits' are reset. */
+Clause *
+import_clause (QBCEPrepro * qr, LitID * lits, unsigned int num_lits)
 {
-  assert (!qr->opened_scope);
   /* Allocate new clause object capable of storing 'num_lits' literals. The
-     literals on the stack 'parsed_literals' will be copied to the new clause
-     object. */
-  int num_lits = COUNT_STACK (qr->parsed_literals);
+     literals in 'lits' will be copied to the new clause object. */
   Clause *clause = mm_malloc (qr->mm, sizeof (Clause) +
                               num_lits * sizeof (LitID));
   clause->id = ++qr->cur_clause_id;
-  ABORT_APP (clause->id > qr->declared_num_clauses,
-                   "actual number of clauses exceeds declared number of clauses!");
   clause->num_lits = num_lits;
 
-  /* Add the parsed clause to the formula and to the stacks of variable
+  /* Add the clause to the formula and to the stacks of variable
      occurrences, provided that it does not contain complementary or multiple
      literals of the same variable. */
-  check_and_add_clause (qr, clause);
+  check_and_add_clause (qr, clause, lits);
 
   if (qr->options.verbosity >= 2)
     {
       fprintf (stderr, "Imported clause: ");
       print_lits (qr, stderr, clause->lits, clause->num_lits, 1);
     }
+
+  return clause;
 }
 
-/* Add parsed scope to data structures. */
+/* -------------------- START: VARIABLE COMPACTION -------------------- */
+
+/* If variables are compacted, the prefix is parsed before the variable
+   table is allocated: the declared variable IDs are collected in the hash
+   map 'var_map' and kept in the scopes as they are. The table is set up by
+   'set_up_compacted_var_table' for the declared variables only, once the
+   prefix is complete, and the literals of clauses are mapped to the
+   compacted IDs as they are parsed. Thus a preamble with a huge maximum ID
+   does not cost memory for variables which are not declared. */
+
+static unsigned int
+hash_var_id (VarID id)
+{
+  unsigned int h = id * 0x9e3779b1u;
+  return h ^ (h >> 16);
+}
+
+/* Return the entry of 'orig' in the hash map of declared variables, or the
+   empty entry where it is inserted. The map must not be empty. */
+static VarMapEntry *
+find_var_map_entry (QBCEPrepro * qr, VarID orig)
+{
+  size_t mask = qr->var_map_size - 1, i = hash_var_id (orig) & mask;
+  while (qr->var_map[i].orig && qr->var_map[i].orig != orig)
+    i = (i + 1) & mask;
+  return qr->var_map + i;
+}
+
+/* Double the size of the hash map of declared variables. */
 static void
-import_parsed_scope_variables (QBCEPrepro * qr)
+enlarge_var_map (QBCEPrepro * qr)
+{
+  size_t old_size = qr->var_map_size;
+  VarMapEntry *old = qr->var_map;
+  size_t size = old_size ? 2 * old_size : 64;
+  qr->var_map = mm_malloc (qr->mm, size * sizeof (VarMapEntry));
+  qr->var_map_size = size;
+  VarMapEntry *p, *e;
+  for (p = old, e = p + old_size; p < e; p++)
+    if (p->orig)
+      *find_var_map_entry (qr, p->orig) = *p;
+  if (old)
+    mm_free (qr->mm, old, old_size * sizeof (VarMapEntry));
+}
+
+/* Add variable 'orig' declared in the prefix to the hash map. */
+static void
+declare_compacted_var (QBCEPrepro * qr, VarID orig)
+{
+  ABORT_APP (orig > qr->declared_max_var_id,
+             "variable ID in scope exceeds max. ID given in preamble!");
+  /* Keep the load factor of the map at most 1/2. */
+  if (2 * (qr->var_map_cnt + 1) > qr->var_map_size)
+    enlarge_var_map (qr);
+  VarMapEntry *entry = find_var_map_entry (qr, orig);
+  ABORT_APP (entry->orig, "variable already quantified!\n");
+  entry->orig = orig;
+  qr->var_map_cnt++;
+}
+
+static int
+compare_var_ids (const void *a, const void *b)
+{
+  VarID x = *(const VarID *) a, y = *(const VarID *) b;
+  return x < y ? -1 : x > y;
+}
+
+/* Allocate the variable table for the variables declared in the prefix,
+   which are numbered densely from 1 in the order of their IDs, and
+   renumber the prefix. Unless renumbering is requested, the original ID of
+   each variable is kept in 'orig_var_ids' for output. Called once the
+   prefix has been parsed. */
+static void
+set_up_compacted_var_table (QBCEPrepro * qr)
+{
+  VarID size = qr->var_map_cnt + 1, id = 0;
+  set_up_var_table (qr, size - 1);
+  VarID *orig = mm_malloc (qr->mm, size * sizeof (VarID));
+  VarMapEntry *p, *e;
+  for (p = qr->var_map, e = p + qr->var_map_size; p < e; p++)
+    if (p->orig)
+      orig[++id] = p->orig;
+  assert (id + 1 == size);
+  qsort (orig + 1, size - 1, sizeof (VarID), compare_var_ids);
+  for (id = 1; id < size; id++)
+    find_var_map_entry (qr, orig[id])->id = id;
+
+  Scope *s;
+  for (s = qr->pcnf.scopes.first; s; s = s->link.next)
+    {
+      VarID *vp, *ve;
+      for (vp = s->vars.start, ve = s->vars.top; vp < ve; vp++)
+        {
+          id = find_var_map_entry (qr, *vp)->id;
+          *vp = id;
+          qr->pcnf.vars[id].id = id;
+          qr->pcnf.vars[id].scope = s;
+        }
+    }
+
+  if (qr->options.compact_vars == 1)
+    {
+      qr->orig_var_ids = orig;
+      qr->orig_size_vars = qr->declared_max_var_id + 1;
+    }
+  else
+    mm_free (qr->mm, orig, size * sizeof (VarID));
+
+  if (qr->options.verbosity >= 1)
+    fprintf (stderr, "compacted %u variable IDs to %u\n",
+             qr->declared_max_var_id, size - 1);
+}
+
+/* Replace the variable IDs of the literals of the parsed clause by their
+   compacted IDs. The first clause completes the prefix. */
+static void
+compact_parsed_clause (QBCEPrepro * qr)
+{
+  if (!qr->pcnf.vars)
+    set_up_compacted_var_table (qr);
+  LitID *p, *e;
+  for (p = qr->parsed_literals.start, e = qr->parsed_literals.top; p < e;
+       p++)
+    {
+      VarID varid = LIT2VARID (*p);
+      ABORT_APP (varid > qr->declared_max_var_id,
+                 "variable ID in clause exceeds max. ID given in preamble!");
+      VarMapEntry *entry =
+        qr->var_map_size ? find_var_map_entry (qr, varid) : 0;
+      ABORT_APP (!entry || !entry->orig,
+                 "variable has not been declared in a scope!");
+      *p = LIT_NEG (*p) ? -(LitID) entry->id : (LitID) entry->id;
+    }
+}
+
+/* -------------------- END: VARIABLE COMPACTION -------------------- */
+
+/* Hash of the 'num_lits' literals in 'lits' which does not depend on their
+   order, such that clauses need not be sorted. */
+static unsigned int
+hash_literals (LitID * lits, unsigned int num_lits)
+{
+  unsigned int hash = num_lits;
+  LitID *p, *e;
+  for (p = lits, e = p + num_lits; p < e; p++)
+    {
+      unsigned int h = (unsigned int) *p * 0x9e3779b1u;
+      h ^= h >> 15;
+      h *= 0x85ebca6bu;
+      h ^= h >> 13;
+      hash += h;
+    }
+  return hash;
+}
+
+/* Double the size of the open-addressing hash set of parsed clauses. */
+static void
+enlarge_clause_set (QBCEPrepro * qr)
+{
+  size_t old_size = qr->clause_set_size;
+  ClauseSetEntry *old = qr->clause_set;
+  size_t size = old_size ? 2 * old_size : 1024;
+  qr->clause_set = mm_malloc (qr->mm, size * sizeof (ClauseSetEntry));
+  qr->clause_set_size = size;
+  size_t mask = qr->clause_set_size - 1;
+  ClauseSetEntry *p, *e;
+  for (p = old, e = p + old_size; p < e; p++)
+    if (p->clause)
+      {
+        size_t i = p->hash & mask;
+        while (qr->clause_set[i].clause)
+          i = (i + 1) & mask;
+        qr->clause_set[i] = *p;
+      }
+  if (old)
+    mm_free (qr->mm, old, old_size * sizeof (ClauseSetEntry));
+}
+
+/* Return nonzero if 'clause' consists of the 'num_lits' literals in 'lits',
+   whose variables are marked by their signs. Since clauses do not contain
+   multiple literals of a variable, this holds iff the sizes are equal and
+   all literals of 'clause' are marked. */
+static int
+same_literals (QBCEPrepro * qr, Clause * clause, unsigned int num_lits)
+{
+  if (clause->num_lits != num_lits)
+    return 0;
+  LitID *p, *e;
+  for (p = clause->lits, e = p + clause->num_lits; p < e; p++)
+    {
+      Var *var = LIT2VARPTR (qr->pcnf.vars, *p);
+      if (LIT_NEG (*p) ? !VAR_NEG_MARKED (var) : !VAR_POS_MARKED (var))
+        return 0;
+    }
+  return 1;
+}
+
+/* Return nonzero if a clause with the 'num_lits' literals in 'lits' has
+   already been parsed. Otherwise, the position of 'hash' in the set is
+   returned in 'pos'. */
+static int
+find_duplicate (QBCEPrepro * qr, LitID * lits, unsigned int num_lits,
+                unsigned int hash, size_t * pos)
+{
+  LitID *p, *e;
+  for (p = lits, e = p + num_lits; p < e; p++)
+    if (LIT2VARID (*p) >= qr->pcnf.size_vars)
+      {
+        /* Let 'import_clause' report the invalid literal. */
+        *pos = qr->clause_set_size;
+        return 0;
+      }
+
+  for (p = lits, e = p + num_lits; p < e; p++)
+    if (LIT_NEG (*p))
+      VAR_NEG_MARK (LIT2VARPTR (qr->pcnf.vars, *p));
+    else
+      VAR_POS_MARK (LIT2VARPTR (qr->pcnf.vars, *p));
+
+  size_t mask = qr->clause_set_size - 1, i = hash & mask;
+  int found = 0;
+  for (; qr->clause_set[i].clause && !found; i = (i + 1) & mask)
+    found = qr->clause_set[i].hash == hash &&
+      same_literals (qr, qr->clause_set[i].clause, num_lits);
+  *pos = i;
+
+  for (p = lits, e = p + num_lits; p < e; p++)
+    VAR_UNMARK (LIT2VARPTR (qr->pcnf.vars, *p));
+  return found;
+}
+
+/* Check and add a parsed clause to the PCNF data structures. If duplicates
+   are removed, then a clause which has already been parsed is dropped but
+   still counted, such that clause IDs keep matching the input. */
+static void
+import_parsed_clause (QBCEPrepro * qr)
+{
+  assert (!qr->opened_scope);
+  ABORT_APP (qr->cur_clause_id >= qr->declared_num_clauses,
+                   "actual number of clauses exceeds declared number of clauses!");
+  if (qr->options.compact_vars)
+    compact_parsed_clause (qr);
+  LitID *lits = qr->parsed_literals.start;
+  unsigned int num_lits = COUNT_STACK (qr->parsed_literals);
+  if (!qr->options.dedup)
+    {
+      import_clause (qr, lits, num_lits);
+      return;
+    }
+
+  /* Keep the load factor of the set at most 1/2. */
+  if (2 * (qr->clause_set_cnt + 1) > qr->clause_set_size)
+    enlarge_clause_set (qr);
+  unsigned int hash = hash_literals (lits, num_lits);
+  size_t pos;
+  if (find_duplicate (qr, lits, num_lits, hash, &pos))
+    {
+      qr->cur_clause_id++;
+      qr->stats.duplicate_clauses++;
+      return;
+    }
+  Clause *clause = import_clause (qr, lits, num_lits);
+  qr->clause_set[pos].clause = clause;
+  qr->clause_set[pos].hash = hash;
+  qr->clause_set_cnt++;
+}
+
+/* Add the 'num_vars' variable IDs in 'vars' to the most recently opened
+   scope. */
+static void
+import_scope_variables (QBCEPrepro * qr, LitID * vars, unsigned int num_vars)
 {
   assert (qr->opened_scope);
   assert (EMPTY_STACK (qr->opened_scope->vars));
   LitID *p, *e;
-  for (p = qr->parsed_literals.start, e = qr->parsed_literals.top; p < e; p++)
+  for (p = vars, e = p + num_vars; p < e; p++)
     {
       LitID varid = *p;
       ABORT_APP (varid <= 0,
                        "variable ID in scope must be positive!\n");
+      if (!qr->pcnf.vars)
+        {
+          /* Variables are compacted once the prefix is complete. */
+          declare_compacted_var (qr, varid);
+          PUSH_STACK (qr->mm, qr->opened_scope->vars, varid);
+          continue;
+        }
       ABORT_APP ((VarID) varid >= qr->pcnf.size_vars,
                        "variable ID in scope exceeds max. ID given in preamble!");
 
@@ -199,6 +483,31 @@ import_parsed_scope_variables (QBCEPrepro * qr)
           (!qr->opened_scope->link.prev && !qr->opened_scope->link.next));
 }
 
+/* Add parsed scope to data structures. */
+static void
+import_parsed_scope_variables (QBCEPrepro * qr)
+{
+  ABORT_APP (qr->options.compact_vars && qr->pcnf.vars,
+             "scopes must precede clauses if variables are compacted!\n");
+  import_scope_variables (qr, qr->parsed_literals.start,
+                          COUNT_STACK (qr->parsed_literals));
+}
+
+/* Append a new scope of type 'scope_type' holding the 'num_vars' variable
+   IDs in 'vars' to the prefix. Non-static to build formulas without
+   parsing. */
+void
+import_scope (QBCEPrepro * qr, QuantifierType scope_type, LitID * vars,
+              unsigned int num_vars)
+{
+  ABORT_APP (qr->opened_scope, "scope opened during parsing!\n");
+  ABORT_APP (!qr->pcnf.vars, "variable table not set up!\n");
+  ABORT_APP (qr->pcnf.clauses.first, "scope added after clauses!\n");
+  open_new_scope (qr, scope_type);
+  import_scope_variables (qr, vars, num_vars);
+  qr->opened_scope = 0;
+}
+
 /* Collect parsed literals of a scope or a clause on auxiliary stack to be
    imported and added to data structures later. */
 static void
@@ -239,8 +548,275 @@ collect_parsed_literal (QBCEPrepro * qr, int num)
   while (isspace (c))                                \
     c = getc (in);
 
-/* Non-static top-level function for parsing. */
-void parse (QBCEPrepro * qr, FILE * in)
+/* Push all clauses on the stacks of occurrences of their literals. Called
+   once after parsing: the number of occurrences of every literal is counted
+   in a first pass over the clauses, such that each stack is allocated only
+   once with its final size, and the stacks are filled in a second one. The
+   stacks are allocated one after the other, hence in external memory mode
+   both passes go through the clauses in the order they are laid out in the
+   file, and the stacks are filled at offsets fixed in advance. */
+static void
+build_occurrences (QBCEPrepro * qr)
+{
+  Var *vars = qr->pcnf.vars;
+  VarID size = qr->pcnf.size_vars;
+  size_t bytes = 2 * size * sizeof (unsigned int);
+  /* Counters of negative and positive literals of variable 'id' are at
+     positions '2 * id' and '2 * id + 1', respectively. */
+  unsigned int *cnt = mm_malloc (qr->mm, bytes);
+  Clause *c;
+  LitID *p, *e;
+
+  for (c = qr->pcnf.clauses.first; c; c = c->link.next)
+    {
+      for (p = c->lits, e = p + c->num_lits; p < e; p++)
+        cnt[2 * LIT2VARID (*p) + LIT_POS (*p)]++;
+      MM_EXT_TOUCH (qr->mm, c, CLAUSE_BYTES (c));
+    }
+
+  Var *vp, *ve;
+  for (vp = vars, ve = vp + size; vp < ve; vp++)
+    {
+      ADJUST_STACK (qr->mm, vp->neg_occ_clauses, cnt[2 * (vp - vars)]);
+      ADJUST_STACK (qr->mm, vp->pos_occ_clauses, cnt[2 * (vp - vars) + 1]);
+    }
+  mm_free (qr->mm, cnt, bytes);
+
+  for (c = qr->pcnf.clauses.first; c; c = c->link.next)
+    {
+      for (p = c->lits, e = p + c->num_lits; p < e; p++)
+        {
+          ClausePtrStack *occs = LIT_NEG (*p) ?
+            &vars[LIT2VARID (*p)].neg_occ_clauses :
+            &vars[LIT2VARID (*p)].pos_occ_clauses;
+          PUSH_STACK (qr->mm, *occs, c);
+          MM_EXT_TOUCH (qr->mm, occs->top - 1, sizeof (Clause *));
+        }
+      MM_EXT_TOUCH (qr->mm, c, CLAUSE_BYTES (c));
+    }
+}
+
+/* Order clause blocks by size, then by address. */
+static int
+compare_clause_blocks (const void *a, const void *b)
+{
+  const Clause *x = *(Clause * const *) a, *y = *(Clause * const *) b;
+  if (x->num_lits != y->num_lits)
+    return x->num_lits < y->num_lits ? -1 : 1;
+  uintptr_t px = (uintptr_t) x, py = (uintptr_t) y;
+  return px < py ? -1 : px > py;
+}
+
+/* Relabel the variables and lay out the clauses in the order of a
+   breadth-first search over the graph of clauses and their variables,
+   starting from the clauses in formula order, in the spirit of
+   Cuthill-McKee. Clauses sharing variables and variables sharing clauses
+   are then close to each other in memory. The order of the clause list,
+   clause IDs and the variable IDs in the output are not changed, the latter
+   by mapping the new IDs back via 'orig_var_ids'. Called before the
+   occurrences are built. */
+static void
+reorder_formula (QBCEPrepro * qr)
+{
+  Var *vars = qr->pcnf.vars;
+  VarID size = qr->pcnf.size_vars, v;
+  unsigned int num_clauses = qr->pcnf.clauses.cnt, i, j, max_lits = 0;
+  Clause **clauses = mm_malloc (qr->mm, num_clauses * sizeof (Clause *));
+
+  /* Index of the clauses containing each variable, where the clauses of
+     variable 'v' are at positions 'start[v]' to 'start[v + 1] - 1'. */
+  size_t *start = mm_malloc (qr->mm, (size + 1) * sizeof (size_t));
+  Clause *c;
+  LitID *p, *e;
+  size_t num_lits = 0, k;
+  for (c = qr->pcnf.clauses.first, i = 0; c; c = c->link.next, i++)
+    {
+      clauses[i] = c;
+      for (p = c->lits, e = p + c->num_lits; p < e; p++)
+        start[LIT2VARID (*p)]++;
+      num_lits += c->num_lits;
+      if (c->num_lits > max_lits)
+        max_lits = c->num_lits;
+      MM_EXT_TOUCH (qr->mm, c, CLAUSE_BYTES (c));
+    }
+  size_t sum = 0;
+  for (v = 0; v <= size; v++)
+    {
+      sum += v < size ? start[v] : 0;
+      start[v] = sum;
+    }
+  unsigned int *occs = mm_malloc (qr->mm, (num_lits + 1) *
+                                  sizeof (unsigned int));
+  for (i = num_clauses; i-- > 0;)
+    {
+      for (p = clauses[i]->lits, e = p + clauses[i]->num_lits; p < e; p++)
+        occs[--start[LIT2VARID (*p)]] = i;
+      MM_EXT_TOUCH (qr->mm, clauses[i], CLAUSE_BYTES (clauses[i]));
+    }
+  /* The index is accessed all over, hence counted as a whole per pass. */
+  MM_EXT_TOUCH (qr->mm, occs, (num_lits + 1) * sizeof (unsigned int));
+
+  /* Breadth-first search, where 'order' serves as queue of clause indices
+     and clauses are marked when enqueued. Variables get their new IDs
+     'map[v]' in the order they are reached, 'perm' is the inverse. */
+  unsigned int *order = mm_malloc (qr->mm, (num_clauses + 1) *
+                                   sizeof (unsigned int));
+  VarID *map = mm_malloc (qr->mm, size * sizeof (VarID));
+  VarID *perm = mm_malloc (qr->mm, size * sizeof (VarID));
+  unsigned int head = 0, tail = 0;
+  VarID next = 1;
+  for (i = 0; i < num_clauses; i++)
+    {
+      if (clauses[i]->mark)
+        continue;
+      clauses[i]->mark = 1;
+      order[tail++] = i;
+      while (head < tail)
+        {
+          c = clauses[order[head++]];
+          MM_EXT_TOUCH (qr->mm, c, CLAUSE_BYTES (c));
+          for (p = c->lits, e = p + c->num_lits; p < e; p++)
+            {
+              v = LIT2VARID (*p);
+              if (map[v])
+                continue;
+              map[v] = next;
+              perm[next++] = v;
+              for (k = start[v]; k < start[v + 1]; k++)
+                {
+                  if (!clauses[occs[k]]->mark)
+                    {
+                      clauses[occs[k]]->mark = 1;
+                      order[tail++] = occs[k];
+                    }
+                  MM_EXT_TOUCH (qr->mm, clauses[occs[k]], sizeof (Clause));
+                }
+            }
+        }
+    }
+  MM_EXT_TOUCH (qr->mm, occs, (num_lits + 1) * sizeof (unsigned int));
+  MM_EXT_TOUCH (qr->mm, clauses, num_clauses * sizeof (Clause *));
+  mm_free (qr->mm, occs, (num_lits + 1) * sizeof (unsigned int));
+  mm_free (qr->mm, start, (size + 1) * sizeof (size_t));
+  /* Variables without occurrences keep their relative order. */
+  for (v = 1; v < size; v++)
+    if (!map[v])
+      {
+        map[v] = next;
+        perm[next++] = v;
+      }
+  assert (next == size);
+
+  Var *reordered = mm_malloc (qr->mm, size * sizeof (Var));
+  reordered[0] = vars[0];
+  for (v = 1; v < size; v++)
+    {
+      reordered[map[v]] = vars[v];
+      reordered[map[v]].id = map[v];
+    }
+  Scope *s;
+  for (s = qr->pcnf.scopes.first; s; s = s->link.next)
+    {
+      VarID *vp, *ve;
+      for (vp = s->vars.start, ve = s->vars.top; vp < ve; vp++)
+        *vp = map[*vp];
+    }
+  for (i = 0; i < num_clauses; i++)
+    {
+      for (p = clauses[i]->lits, e = p + clauses[i]->num_lits; p < e; p++)
+        *p = LIT_NEG (*p) ? -(LitID) map[-*p] : (LitID) map[*p];
+      MM_EXT_TOUCH (qr->mm, clauses[i], CLAUSE_BYTES (clauses[i]));
+    }
+
+  /* Print variables with their IDs before reordering, which are the
+     original ones unless compacted variables are renumbered. */
+  VarID *out = mm_malloc (qr->mm, size * sizeof (VarID));
+  for (v = 1; v < size; v++)
+    out[v] = qr->orig_var_ids ? qr->orig_var_ids[perm[v]] : perm[v];
+  if (qr->orig_var_ids)
+    mm_free (qr->mm, qr->orig_var_ids, size * sizeof (VarID));
+  else
+    qr->orig_size_vars = size;
+  qr->orig_var_ids = out;
+  mm_free (qr->mm, vars, size * sizeof (Var));
+  qr->pcnf.vars = reordered;
+  mm_free (qr->mm, perm, size * sizeof (VarID));
+  mm_free (qr->mm, map, size * sizeof (VarID));
+
+  /* Move the clauses into search order in place rather than copying them,
+     which would take twice the memory of the clauses. Blocks of clauses of
+     the same size are interchangeable: sorted by size and address in
+     'blocks', they receive the clauses of that size in search order, where
+     'src[t]' is the index of the clause moved into 'blocks[t]' and
+     'from[t]' the position in 'blocks' it is moved from. The moves are
+     done along the cycles of this permutation. */
+  unsigned int *first = mm_malloc (qr->mm, (max_lits + 2) *
+                                   sizeof (unsigned int));
+  for (i = 0; i < num_clauses; i++)
+    first[clauses[i]->num_lits + 1]++;
+  for (j = 1; j <= max_lits + 1; j++)
+    first[j] += first[j - 1];
+  unsigned int *src = mm_malloc (qr->mm, num_clauses * sizeof (unsigned int));
+  for (j = 0; j < num_clauses; j++)
+    src[first[clauses[order[j]]->num_lits]++] = order[j];
+  mm_free (qr->mm, first, (max_lits + 2) * sizeof (unsigned int));
+  mm_free (qr->mm, order, (num_clauses + 1) * sizeof (unsigned int));
+
+  Clause **blocks = mm_malloc (qr->mm, num_clauses * sizeof (Clause *));
+  memcpy (blocks, clauses, num_clauses * sizeof (Clause *));
+  qsort (blocks, num_clauses, sizeof (Clause *), compare_clause_blocks);
+  unsigned int *from = mm_malloc (qr->mm, num_clauses * sizeof (unsigned int));
+  for (j = 0; j < num_clauses; j++)
+    {
+      Clause **b = bsearch (&clauses[src[j]], blocks, num_clauses,
+                            sizeof (Clause *), compare_clause_blocks);
+      assert (b);
+      from[j] = b - blocks;
+    }
+
+  Clause *tmp = mm_malloc (qr->mm, sizeof (Clause) +
+                           max_lits * sizeof (LitID));
+  for (j = 0; j < num_clauses; j++)
+    {
+      if (from[j] == j)
+        continue;
+      size_t bytes = CLAUSE_BYTES (blocks[j]);
+      memcpy (tmp, blocks[j], bytes);
+      unsigned int cur = j;
+      while (from[cur] != j)
+        {
+          memcpy (blocks[cur], blocks[from[cur]], bytes);
+          MM_EXT_TOUCH (qr->mm, blocks[cur], bytes);
+          MM_EXT_TOUCH (qr->mm, blocks[from[cur]], bytes);
+          unsigned int prev = cur;
+          cur = from[cur];
+          from[prev] = prev;
+        }
+      memcpy (blocks[cur], tmp, bytes);
+      from[cur] = cur;
+    }
+  mm_free (qr->mm, tmp, sizeof (Clause) + max_lits * sizeof (LitID));
+  mm_free (qr->mm, from, num_clauses * sizeof (unsigned int));
+
+  /* Relink the clauses at their new places in the order of the formula. */
+  for (j = 0; j < num_clauses; j++)
+    clauses[src[j]] = blocks[j];
+  memset (&qr->pcnf.clauses, 0, sizeof (ClauseList));
+  for (i = 0; i < num_clauses; i++)
+    {
+      c = clauses[i];
+      c->mark = 0;
+      c->link.prev = c->link.next = 0;
+      LINK_LAST (qr->pcnf.clauses, c, link);
+    }
+
+  mm_free (qr->mm, blocks, num_clauses * sizeof (Clause *));
+  mm_free (qr->mm, src, num_clauses * sizeof (unsigned int));
+  mm_free (qr->mm, clauses, num_clauses * sizeof (Clause *));
+}
+
+static void
+parse_qdimacs (QBCEPrepro * qr, FILE * in)
 {
   int neg = 0, preamble_found = 0;
   LitID num = 0;
@@ -282,8 +858,11 @@ void parse (QBCEPrepro * qr, FILE * in)
           PARSER_READ_NUM (num, c);
 
           /* Allocate array of variable IDs of size 'num + 1', since 0 is an
-             invalid variable ID. */
-          set_up_var_table (qr, num);
+             invalid variable ID. If variables are compacted, the table is
+             allocated after the prefix has been parsed. */
+          qr->declared_max_var_id = num;
+          if (!qr->options.compact_vars)
+            set_up_var_table (qr, num);
 
           PARSER_SKIP_SPACE_WHILE (c);
           if (!isdigit (c))
@@ -295,8 +874,8 @@ void parse (QBCEPrepro * qr, FILE * in)
           qr->declared_num_clauses = num;
 
           if (qr->options.verbosity >= 1)
-            fprintf (stderr, "parsed preamble: p cnf %d %d\n",
-                     (qr->pcnf.size_vars - 1), qr->declared_num_clauses);
+            fprintf (stderr, "parsed preamble: p cnf %u %u\n",
+                     qr->declared_max_var_id, qr->declared_num_clauses);
 
           preamble_found = 1;
           goto PARSE_SCOPE_OR_CLAUSE;
@@ -366,5 +945,38 @@ void parse (QBCEPrepro * qr, FILE * in)
     ABORT_APP (1, "preamble missing!\n");
 }
 
+/* Non-static top-level function for parsing. */
+void
+parse (QBCEPrepro * qr, FILE * in)
+{
+  qbce_phase_start (&qr->stats.parse);
+  qr->parsing = 1;
+  parse_qdimacs (qr, in);
+  qr->parsing = 0;
+  /* A formula without clauses. */
+  if (qr->options.compact_vars && !qr->pcnf.vars)
+    set_up_compacted_var_table (qr);
+  if (qr->var_map)
+    {
+      mm_free (qr->mm, qr->var_map, qr->var_map_size * sizeof (VarMapEntry));
+      qr->var_map = 0;
+      qr->var_map_size = qr->var_map_cnt = 0;
+    }
+  if (qr->clause_set)
+    {
+      mm_free (qr->mm, qr->clause_set,
+               qr->clause_set_size * sizeof (ClauseSetEntry));
+      qr->clause_set = 0;
+      qr->clause_set_size = qr->clause_set_cnt = 0;
+    }
+  if (qr->options.reorder)
+    reorder_formula (qr);
+  qbce_phase_stop (&qr->stats.parse);
+
+  qbce_phase_start (&qr->stats.occurrences);
+  build_occurrences (qr);
+  qbce_phase_stop (&qr->stats.occurrences);
+}
+
 /* -------------------- END: QDIMACS PARSING -------------------- */
 
@@ -26,4 +26,11 @@
 
 void parse (QBCEPrepro * qr, FILE * in);
 
+void set_up_var_table (QBCEPrepro * qr, int num);
+
+void import_scope (QBCEPrepro * qr, QuantifierType scope_type, LitID * vars,
+                   unsigned int num_vars);
+
+Clause *import_clause (QBCEPrepro * qr, LitID * lits, unsigned int num_lits);
+
 #endif
@@ -191,6 +191,14 @@ struct Clause
   unsigned int blocked:1;
   /* Multi-purpose mark. */
   unsigned int mark:1;
+  /* Mark indicating that the blocked clause was eliminated by QHBCE or
+     QCBCE, which may rely on the presence of other clauses. */
+  unsigned int extended:1;
+  /* Number of literals removed from the clause by simplifications, which
+     is needed to release the clause. */
+  unsigned int num_removed_lits:29;
+  /* Literal the clause is blocked on, valid only if 'blocked' is set. */
+  LitID blocking_lit;
 
   /* All  clauses are kept in a doubly linked list. */
   ClauseLink link;
@@ -211,6 +219,10 @@ struct Clause
 #define LIT2VARPTR(vars, lit) ((vars) + LIT2VARID(lit))
 #define LIT2VAR(vars, lit) ((vars)[LIT2VARID(lit)])
 
+/* Number of bytes allocated for clause 'c'. */
+#define CLAUSE_BYTES(c)					\
+  (sizeof (Clause) + ((c)->num_lits + (c)->num_removed_lits) * sizeof (LitID))
+
 /* Convert variable ID to pointer to variable object. */
 #define VARID2VARPTR(vars, id) ((vars) + (id))
 
@@ -0,0 +1,388 @@
+/*
+ This file is part of qbce-prepro.
+
+ Copyright 2018 
+ Florian Lonsing, Vienna University of Technology, Austria.
+
+ qbce-prepro is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or (at
+ your option) any later version.
+
+ qbce-prepro is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with qbce-prepro.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* Generator of random and structured QDIMACS formulas for scaling
+   experiments. Clauses are streamed to the output and never stored, hence
+   formulas of any size can be generated in constant memory. The output
+   depends only on the options, including the seed. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pcnf.h"
+#include "writer.h"
+#include "error.h"
+
+#define GEN_USAGE \
+"usage: ./qbce-gen [options]\n"\
+"\n"\
+"    --vars=<n>         number of variables (default: 1000)\n"\
+"    --clauses=<n>      number of clauses (default: 4000)\n"\
+"    --depth=<n>        number of quantifier blocks, innermost one is\n"\
+"                         existential (default: 4)\n"\
+"    --exists=<r>       ratio of existential variables (default: 0.6)\n"\
+"    --min=<n>          minimum clause length (default: 2)\n"\
+"    --max=<n>          maximum clause length (default: 6)\n"\
+"    --dist=<d>         clause length distribution: 'uniform' or 'geometric'\n"\
+"                         (length min+k with probability ~ 2^-k)\n"\
+"    --planted=<f>      fraction of clauses which are planted blocked\n"\
+"                         clauses (default: 0)\n"\
+"    --locality=<w>     structured formula: variables of a clause are taken\n"\
+"                         from a window of <w> consecutive IDs moving along\n"\
+"                         with the clause index (default: 0, i.e. random)\n"\
+"    --seed=<n>         seed of the random number generator (default: 1)\n"\
+"    -o <file>          output file (default: stdout)\n"\
+"\n"
+
+/* Maximum clause length. */
+#define GEN_MAX_LEN 1024
+
+/* Number of planted blocked clauses per pivot variable. */
+#define GEN_CLAUSES_PER_PIVOT 4
+
+struct GenOptions
+{
+  unsigned long long num_vars;
+  unsigned long long num_clauses;
+  unsigned int depth;
+  double exists_ratio;
+  unsigned int min_len;
+  unsigned int max_len;
+  int geometric;
+  double planted;
+  unsigned long long locality;
+  unsigned long long seed;
+};
+
+typedef struct GenOptions GenOptions;
+
+/* Generator state: quantifier block of every variable (blocks are ranges
+   of consecutive IDs) and reserved pivot variables of planted clauses. */
+struct Gen
+{
+  GenOptions opts;
+  unsigned long long rng;
+  /* First variable ID of block 'i' is 'block_start[i]', for
+     'i = 0..depth'; 'block_start[depth]' is one past the last ID. */
+  unsigned long long *block_start;
+  /* Pivots are the last 'num_pivots' IDs of the innermost block. */
+  unsigned long long num_pivots;
+  unsigned long long first_pivot;
+};
+
+typedef struct Gen Gen;
+
+/* xorshift64* generator. */
+static unsigned long long
+gen_rand (Gen * g)
+{
+  g->rng ^= g->rng >> 12;
+  g->rng ^= g->rng << 25;
+  g->rng ^= g->rng >> 27;
+  return g->rng * 2685821657736338717ULL;
+}
+
+/* Uniformly random number in '[0, n)'. */
+static unsigned long long
+gen_below (Gen * g, unsigned long long n)
+{
+  return (gen_rand (g) >> 11) % n;
+}
+
+static double
+gen_unit (Gen * g)
+{
+  return (gen_rand (g) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Innermost block is existential, types alternate outwards. */
+static int
+block_exists (Gen * g, unsigned int block)
+{
+  return (g->opts.depth - 1 - block) % 2 == 0;
+}
+
+/* Distribute variables over blocks: existential variables evenly over the
+   existential blocks, universal ones over the universal blocks. */
+static void
+set_up_blocks (Gen * g)
+{
+  GenOptions *o = &g->opts;
+  unsigned int num_e = (o->depth + 1) / 2, num_a = o->depth / 2, i;
+  unsigned long long vars_e = o->num_vars * o->exists_ratio + 0.5;
+  if (!num_a)
+    vars_e = o->num_vars;
+  if (vars_e < num_e)
+    vars_e = num_e;
+  unsigned long long vars_a = o->num_vars - vars_e;
+  ABORT_APP (num_a && vars_a < num_a, "too few universal variables!");
+
+  g->block_start = malloc ((o->depth + 1) * sizeof (unsigned long long));
+  ABORT_APP (!g->block_start, "could not allocate memory!");
+  unsigned long long next = 1;
+  unsigned int seen_e = 0, seen_a = 0;
+  for (i = 0; i < o->depth; i++)
+    {
+      g->block_start[i] = next;
+      if (block_exists (g, i))
+        next += vars_e / num_e + (seen_e++ < vars_e % num_e);
+      else
+        next += vars_a / num_a + (seen_a++ < vars_a % num_a);
+    }
+  g->block_start[o->depth] = next;
+
+  unsigned long long num_planted = o->num_clauses * o->planted;
+  unsigned long long inner = next - g->block_start[o->depth - 1];
+  g->num_pivots = (num_planted + GEN_CLAUSES_PER_PIVOT - 1) /
+    GEN_CLAUSES_PER_PIVOT;
+  ABORT_APP (num_planted && g->num_pivots >= inner,
+             "too few innermost variables for planted clauses!");
+  g->first_pivot = next - g->num_pivots;
+}
+
+static unsigned int
+block_of (Gen * g, unsigned long long var)
+{
+  unsigned int lo = 0, hi = g->opts.depth - 1;
+  while (lo < hi)
+    {
+      unsigned int mid = (lo + hi + 1) / 2;
+      if (g->block_start[mid] <= var)
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+  return lo;
+}
+
+static unsigned int
+clause_length (Gen * g)
+{
+  GenOptions *o = &g->opts;
+  unsigned int len = o->min_len;
+  if (o->geometric)
+    while (len < o->max_len && (gen_rand (g) >> 63))
+      len++;
+  else
+    len += gen_below (g, o->max_len - o->min_len + 1);
+  return len;
+}
+
+/* Random non-pivot variable, taken from the window of the current clause in
+   structured formulas. */
+static unsigned long long
+random_var (Gen * g, unsigned long long clause_index)
+{
+  unsigned long long range = g->first_pivot - 1;
+  if (!g->opts.locality || g->opts.locality >= range)
+    return 1 + gen_below (g, range);
+  unsigned long long offset =
+    (clause_index * (range - g->opts.locality)) / g->opts.num_clauses;
+  return 1 + offset + gen_below (g, g->opts.locality);
+}
+
+static int
+has_var (LitID * lits, unsigned int num, unsigned long long var)
+{
+  unsigned int i;
+  for (i = 0; i < num; i++)
+    if ((unsigned long long) LIT2VARID (lits[i]) == var)
+      return 1;
+  return 0;
+}
+
+static LitID
+random_sign (Gen * g, unsigned long long var)
+{
+  return gen_rand (g) >> 63 ? -(LitID) var : (LitID) var;
+}
+
+/* Generate clause number 'index' into 'lits' and return its length. Planted
+   clauses contain a pivot 'x' and its partner 'y' from an outer block or
+   the same block, with equal signs. Since all clauses containing 'x' contain
+   'y' and all clauses containing '-x' contain '-y', every planted clause is
+   blocked on its pivot literal. */
+static unsigned int
+generate_clause (Gen * g, unsigned long long index, LitID * lits)
+{
+  unsigned int len = clause_length (g), num = 0;
+  if (g->num_pivots && gen_unit (g) < g->opts.planted)
+    {
+      unsigned long long x = g->first_pivot + gen_below (g, g->num_pivots);
+      /* Partner of 'x' is fixed by 'x'. */
+      unsigned long long y = 1 + (x * 2654435761ULL) % (g->first_pivot - 1);
+      LitID sign = gen_rand (g) >> 63 ? -1 : 1;
+      lits[num++] = sign * (LitID) x;
+      lits[num++] = sign * (LitID) y;
+    }
+  else
+    {
+      /* First literal is existential, such that no clause is reduced to the
+         empty clause by universal reduction. */
+      unsigned long long var = random_var (g, index);
+      unsigned int tries = 0;
+      while (!block_exists (g, block_of (g, var)))
+        {
+          /* The window may lie within universal blocks. */
+          if (++tries < 64)
+            var = random_var (g, index);
+          else
+            var = g->block_start[g->opts.depth - 1] +
+              gen_below (g, g->first_pivot - g->block_start[g->opts.depth - 1]);
+        }
+      lits[num++] = random_sign (g, var);
+    }
+
+  while (num < len)
+    {
+      unsigned long long var = random_var (g, index);
+      if (!has_var (lits, num, var))
+        lits[num++] = random_sign (g, var);
+    }
+  return num;
+}
+
+static void
+generate (Gen * g, FILE * out)
+{
+  GenOptions *o = &g->opts;
+  MemMan *mm = mm_create ();
+  Writer w;
+  writer_init (&w, mm, out);
+  LitID lits[GEN_MAX_LEN];
+  unsigned long long i, v;
+  unsigned int b;
+
+  writer_put_str (&w, "p cnf ");
+  writer_put_int (&w, o->num_vars);
+  writer_put_str (&w, " ");
+  writer_put_int (&w, o->num_clauses);
+  writer_put_str (&w, "\n");
+
+  for (b = 0; b < o->depth; b++)
+    {
+      writer_put_str (&w, block_exists (g, b) ? "e " : "a ");
+      for (v = g->block_start[b]; v < g->block_start[b + 1]; v++)
+        {
+          writer_put_int (&w, (int) v);
+          writer_put_str (&w, " ");
+        }
+      writer_put_str (&w, "0\n");
+    }
+
+  for (i = 0; i < o->num_clauses; i++)
+    {
+      unsigned int num = generate_clause (g, i, lits);
+      writer_put_lits (&w, lits, num);
+    }
+
+  writer_delete (&w);
+  mm_delete (mm);
+}
+
+static int
+match_opt (const char *arg, const char *name, const char **val)
+{
+  size_t len = strlen (name);
+  if (strncmp (arg, name, len))
+    return 0;
+  *val = arg + len;
+  return 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  Gen g;
+  memset (&g, 0, sizeof (Gen));
+  GenOptions *o = &g.opts;
+  o->num_vars = 1000;
+  o->num_clauses = 4000;
+  o->depth = 4;
+  o->exists_ratio = 0.6;
+  o->min_len = 2;
+  o->max_len = 6;
+  o->seed = 1;
+  const char *out_path = 0, *val;
+  int i;
+
+  for (i = 1; i < argc; i++)
+    {
+      const char *arg = argv[i];
+      if (match_opt (arg, "--vars=", &val))
+        o->num_vars = strtoull (val, 0, 10);
+      else if (match_opt (arg, "--clauses=", &val))
+        o->num_clauses = strtoull (val, 0, 10);
+      else if (match_opt (arg, "--depth=", &val))
+        o->depth = atoi (val);
+      else if (match_opt (arg, "--exists=", &val))
+        o->exists_ratio = atof (val);
+      else if (match_opt (arg, "--min=", &val))
+        o->min_len = atoi (val);
+      else if (match_opt (arg, "--max=", &val))
+        o->max_len = atoi (val);
+      else if (match_opt (arg, "--dist=", &val) && !strcmp (val, "uniform"))
+        o->geometric = 0;
+      else if (match_opt (arg, "--dist=", &val) && !strcmp (val, "geometric"))
+        o->geometric = 1;
+      else if (match_opt (arg, "--planted=", &val))
+        o->planted = atof (val);
+      else if (match_opt (arg, "--locality=", &val))
+        o->locality = strtoull (val, 0, 10);
+      else if (match_opt (arg, "--seed=", &val))
+        o->seed = strtoull (val, 0, 10);
+      else if (!strcmp (arg, "-o") && i + 1 < argc)
+        out_path = argv[++i];
+      else
+        {
+          fprintf (stderr, !strcmp (arg, "-h") || !strcmp (arg, "--help") ?
+                   "%s" : "unknown option!\n\n%s", GEN_USAGE);
+          return 1;
+        }
+    }
+
+  ABORT_APP (!o->depth, "depth must be positive!");
+  ABORT_APP (o->num_vars > 2147483647ULL, "too many variables!");
+  ABORT_APP (o->num_clauses > 2147483647ULL, "too many clauses!");
+  ABORT_APP (o->locality && o->locality < o->max_len,
+             "locality window smaller than maximum clause length!");
+  ABORT_APP (!o->min_len || o->min_len > o->max_len
+             || o->max_len > GEN_MAX_LEN, "invalid clause lengths!");
+  ABORT_APP (o->exists_ratio <= 0 || o->exists_ratio > 1,
+             "ratio of existential variables must be in (0, 1]!");
+  ABORT_APP (o->planted < 0 || o->planted > 1,
+             "fraction of planted clauses must be in [0, 1]!");
+  ABORT_APP (o->num_vars < o->depth + o->max_len + 1, "too few variables!");
+
+  /* Never start with state 0, which is a fixed point of xorshift. */
+  g.rng = o->seed * 0x9E3779B97F4A7C15ULL + 1;
+  set_up_blocks (&g);
+  ABORT_APP (g.first_pivot - 1 < o->max_len,
+             "too few variables for maximum clause length!");
+
+  FILE *out = out_path ? fopen (out_path, "w") : stdout;
+  ABORT_APP (!out, "could not open output file!");
+  generate (&g, out);
+  if (out_path)
+    fclose (out);
+  free (g.block_start);
+  return 0;
+}
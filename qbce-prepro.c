@@ -18,40 +18,21 @@
  along with qbce-prepro.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
-#include <sys/resource.h>
 #include <stdlib.h>
-#include <ctype.h>
-#include <limits.h>
-#include <dirent.h>
 #include <assert.h>
 #include <string.h>
-#include <stdarg.h>
-#include <signal.h>
-#include <unistd.h>
+#include <time.h>
 #include "qbce-prepro.h"
 #include "stack.h"
 #include "mem.h"
 #include "parse.h"
 #include "error.h"
-
-/* -------------------- START: Helper macros -------------------- */
-
-#define USAGE \
-"usage: ./qbce-prepro [options] input-formula [timeout]\n"\
-"\n"\
-"  - 'input-formula' is a file in QDIMACS format (default: stdin)\n"\
-"  - '[timeout]' is an optional timeout in seconds\n"\
-"  - '[options]' is any combination of the following:\n\n"\
-"    -h, --help         print this usage information and exit\n"\
-"    --simplify         detect and mark blocked clauses\n"\
-"    --print-formula    print parsed (and simplified) formula to stdout\n"\
-"                         Note: if option '--simplify' is NOT given\n"\
-"                         then the original formula is printed as is\n"\
-"    -v                 increase verbosity level incrementally (default: 0)\n"\
-"\n"
-
-/* -------------------- END: Helper macros -------------------- */
+#include "writer.h"
+#include "checkpoint.h"
 
 /* -------- START: Application defintions and functions -------- */
 
@@ -68,20 +49,12 @@ int findAndMarkBlockedClausesForMarkedVariables(QBCEPrepro *qr);
 
 int considerAndMark(QBCEPrepro * qr, VarID id, int isPosetive);
 
+/* Names of the pipeline stages used by '--pipeline' and in statistics. */
+static const char *stage_names[NUM_STAGES] = {
+    "ur", "up", "pure", "qbce", "qhbce", "qcbce", "qble", "bve", "sub"
+};
 
 
-/* Print error message. */
-static void
-print_abort_err(char *msg, ...) {
-    va_list list;
-    assert (msg != NULL);
-    fprintf(stderr, "qbce-prepro: ");
-    va_start (list, msg);
-    vfprintf(stderr, msg, list);
-    va_end (list);
-    fflush(stderr);
-    abort();
-}
 
 /* Print array 'lits' of literals of length 'num'. If 'print_info' is
 non-zero, then print info about the scope of each literal in the array. */
@@ -105,112 +78,23 @@ print_lits(QBCEPrepro *qr, FILE *out, LitID *lits, unsigned int num,
 
 /* -------- END: Application defintions and functions -------- */
 
-/* -------------------- START: COMMAND LINE PARSING -------------------- */
-static void
-set_default_options(QBCEPrepro *qr) {
-    qr->options.in_filename = 0;
-    qr->options.in = stdin;
-    qr->options.print_usage = 0;
-}
-
-static int
-isnumstr(char *str) {
-    /* Empty string is not considered as number-string. */
-    if (!*str)
-        return 0;
-    char *p;
-    for (p = str; *p; p++) {
-        if (!isdigit (*p))
-            return 0;
-    }
-    return 1;
-}
-
-/* Parse command line arguments to set options accordingly. Run the program
-   with '-h' or '--help' to print usage information. */
-static void
-parse_cmd_line_options(QBCEPrepro *qr, int argc, char **argv) {
-    char *result;
-    int opt_cnt;
-    for (opt_cnt = 1; opt_cnt < argc; opt_cnt++) {
-        char *opt_str = argv[opt_cnt];
-
-        if (!strcmp(opt_str, "-h") || !strcmp(opt_str, "--help")) {
-            qr->options.print_usage = 1;
-        } else if (!strcmp(opt_str, "--simplify")) {
-            qr->options.simplify = 1;
-        } else if (!strncmp(opt_str, "--print-formula", strlen("--print-formula"))) {
-            qr->options.print_formula = 1;
-        } else if (!strcmp(opt_str, "-v")) {
-            qr->options.verbosity++;
-        } else if (isnumstr(opt_str)) {
-            qr->options.max_time = atoi(opt_str);
-            if (qr->options.max_time == 0) {
-                result = "Expecting non-zero value for max-time";
-                print_abort_err("%s!\n\n", result);
-            }
-        } else if (!qr->options.in_filename) {
-            qr->options.in_filename = opt_str;
-            /* Check input file. */
-            DIR *dir;
-            if ((dir = opendir(qr->options.in_filename)) != NULL) {
-                closedir(dir);
-                print_abort_err("input file '%s' is a directory!\n\n",
-                                qr->options.in_filename);
-            }
-            FILE *input_file = fopen(qr->options.in_filename, "r");
-            if (!input_file) {
-                print_abort_err("could not open input file '%s'!\n\n",
-                                qr->options.in_filename);
-            } else
-                qr->options.in = input_file;
-        } else {
-            print_abort_err("unknown option '%s'!\n\n", opt_str);
-        }
-    }
-}
-
-/* -------------------- END: COMMAND LINE PARSING -------------------- */
-
 /* -------------------- START: HELPER FUNCTIONS -------------------- */
 
-/* Set signal handler. */
-static void
-sig_handler(int sig) {
-    fprintf(stderr, "\n\n SIG RECEIVED\n\n");
-    signal(sig, SIG_DFL);
-    raise(sig);
-}
-
-/* Set signal handler. */
-static void
-sigalrm_handler(int sig) {
-    fprintf(stderr, "\n\n SIGALRM RECEIVED\n\n");
-    signal(sig, SIG_DFL);
-    raise(sig);
-}
-
-/* Set signal handler. */
-static void
-set_signal_handlers(void) {
-    signal(SIGINT, sig_handler);
-    signal(SIGTERM, sig_handler);
-    signal(SIGALRM, sigalrm_handler);
-    signal(SIGXCPU, sigalrm_handler);
-}
-
-static void
-print_usage() {
-    fprintf(stdout, USAGE);
-}
-
 /* Free allocated memory. */
 static void
 cleanup(QBCEPrepro *qr) {
-    if (qr->options.in_filename)
-        fclose(qr->options.in);
-
     DELETE_STACK (qr->mm, qr->parsed_literals);
+    DELETE_STACK (qr->mm, qr->stats.rounds);
+    /* Only left if parsing failed. */
+    if (qr->clause_set)
+        mm_free(qr->mm, qr->clause_set,
+                qr->clause_set_size * sizeof(ClauseSetEntry));
+    if (qr->var_map)
+        mm_free(qr->mm, qr->var_map, qr->var_map_size * sizeof(VarMapEntry));
+    if (qr->dep_nesting)
+        mm_free(qr->mm, qr->dep_nesting, qr->pcnf.size_vars * sizeof(Nesting));
+    if (qr->orig_var_ids)
+        mm_free(qr->mm, qr->orig_var_ids, qr->pcnf.size_vars * sizeof(VarID));
 
     Var *vp, *ve;
     for (vp = qr->pcnf.vars, ve = vp + qr->pcnf.size_vars; vp < ve; vp++) {
@@ -229,63 +113,513 @@ cleanup(QBCEPrepro *qr) {
     Clause *c, *cn;
     for (c = qr->pcnf.clauses.first; c; c = cn) {
         cn = c->link.next;
-        mm_free(qr->mm, c, sizeof(Clause) + c->num_lits * sizeof(LitID));
+        mm_free(qr->mm, c, CLAUSE_BYTES (c));
     }
 }
 
 /* Print (simplified) formula to file 'out'. If '--simplify'
-   is specified then blocked clauses will not be printed. */
-static void
-print_formula(QBCEPrepro *qr, FILE *out) {
+   is specified then blocked clauses will not be printed. The formula is
+   written by a buffered writer directly to the file descriptor of 'out'. */
+void
+qbce_print_formula(QBCEPrepro *qr, FILE *out) {
     assert (qr->pcnf.clauses.cnt >= qr->cnt_blocked_clauses);
     /* Print preamble. */
     assert (qr->pcnf.size_vars > 0);
-    fprintf(out, "p cnf %d %d\n", (qr->pcnf.size_vars - 1),
-            (qr->pcnf.clauses.cnt - qr->cnt_blocked_clauses));
+    qbce_phase_start(&qr->stats.output);
+    /* Relabeled variables are printed with their IDs for output. */
+    const VarID *map = qr->orig_var_ids;
+    Writer w;
+    writer_init(&w, qr->mm, out);
+    writer_put_str(&w, "p cnf ");
+    writer_put_int(&w, (map ? qr->orig_size_vars : qr->pcnf.size_vars) - 1);
+    writer_put_str(&w, " ");
+    writer_put_int(&w, qr->pcnf.clauses.cnt - qr->cnt_blocked_clauses);
+    writer_put_str(&w, "\n");
 
     /* Print prefix. */
     Scope *s;
     for (s = qr->pcnf.scopes.first; s; s = s->link.next) {
-        fprintf(out, "%c ", SCOPE_FORALL (s) ? 'a' : 'e');
-        print_lits(qr, out, (LitID *) s->vars.start,
-                   COUNT_STACK (s->vars), 0);
+        writer_put_str(&w, SCOPE_FORALL (s) ? "a " : "e ");
+        if (map)
+            writer_put_mapped_lits(&w, (LitID *) s->vars.start,
+                                   COUNT_STACK (s->vars), map);
+        else
+            writer_put_lits(&w, (LitID *) s->vars.start,
+                            COUNT_STACK (s->vars));
     }
 
     /* Print clauses. */
+    if (qr->options.output_threads > 1) {
+        writer_put_clauses(&w, qr->pcnf.clauses.first, map,
+                           qr->options.output_threads);
+        writer_delete(&w);
+        qbce_phase_stop(&qr->stats.output);
+        return;
+    }
     Clause *c;
-    for (c = qr->pcnf.clauses.first; c; c = c->link.next)
-        if (!c->blocked)
-            print_lits(qr, out, c->lits, c->num_lits, 0);
+    for (c = qr->pcnf.clauses.first; c; c = c->link.next) {
+        if (!c->blocked) {
+            if (map)
+                writer_put_mapped_lits(&w, c->lits, c->num_lits, map);
+            else
+                writer_put_lits(&w, c->lits, c->num_lits);
+        }
+        MM_EXT_TOUCH (qr->mm, c, CLAUSE_BYTES (c));
+    }
+
+    writer_delete(&w);
+    qbce_phase_stop(&qr->stats.output);
 }
 
-/* Get process time. Can be used for performance statistics. */
+/* Blocking literal of @c with the variable ID it is printed with. */
+static LitID
+output_blocking_lit(QBCEPrepro *qr, Clause *c) {
+    LitID lit = c->blocking_lit;
+    if (!qr->orig_var_ids)
+        return lit;
+    VarID v = qr->orig_var_ids[LIT2VARID (lit)];
+    return LIT_NEG (lit) ? -(LitID) v : (LitID) v;
+}
+
+/* Print only the IDs of blocked clauses to 'out'. The clause list is in the
+   order of IDs, hence the output is produced in one pass (two with
+   literals in the bitmap format) without collecting the IDs first. */
+void
+qbce_print_blocked(QBCEPrepro *qr, FILE *out, int bitmap, int with_lits) {
+    qbce_phase_start(&qr->stats.output);
+    Writer w;
+    writer_init(&w, qr->mm, out);
+    Clause *c;
+
+    if (!bitmap) {
+        for (c = qr->pcnf.clauses.first; c; c = c->link.next) {
+            assert (!c->link.prev || c->link.prev->id < c->id);
+            if (!c->blocked)
+                continue;
+            writer_put_int(&w, c->id);
+            if (with_lits) {
+                writer_put_str(&w, " ");
+                writer_put_int(&w, output_blocking_lit(qr, c));
+            }
+            writer_put_str(&w, "\n");
+        }
+    } else {
+        unsigned int header[2] = {qr->cur_clause_id, with_lits ? 1 : 0};
+        writer_put_bytes(&w, QBCE_BLOCKED_MAGIC, 8);
+        writer_put_bytes(&w, header, sizeof(header));
+        /* Byte 'cur' of the bitmap is collected in 'byte' until a clause
+           with an ID beyond it is reached. */
+        size_t cur = 0, num_bytes = ((size_t) qr->cur_clause_id + 7) / 8;
+        unsigned char byte = 0;
+        for (c = qr->pcnf.clauses.first; c; c = c->link.next) {
+            assert (!c->link.prev || c->link.prev->id < c->id);
+            if (!c->blocked)
+                continue;
+            for (; cur < (c->id - 1) / 8; cur++, byte = 0)
+                writer_put_bytes(&w, &byte, 1);
+            byte |= 1 << ((c->id - 1) % 8);
+        }
+        for (; cur < num_bytes; cur++, byte = 0)
+            writer_put_bytes(&w, &byte, 1);
+        if (with_lits)
+            for (c = qr->pcnf.clauses.first; c; c = c->link.next)
+                if (c->blocked) {
+                    LitID lit = output_blocking_lit(qr, c);
+                    writer_put_bytes(&w, &lit, sizeof(LitID));
+                }
+    }
+
+    writer_delete(&w);
+    qbce_phase_stop(&qr->stats.output);
+}
+
+/* Read clock 'clock' in seconds. */
 static double
-time_stamp() {
-    double result = 0;
-    struct rusage usage;
+read_clock(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+double
+qbce_wall_time(void) {
+    return read_clock(CLOCK_MONOTONIC);
+}
+
+void
+qbce_phase_start(PhaseTime *t) {
+    t->wall -= read_clock(CLOCK_MONOTONIC);
+    /* CPU time of the calling thread, such that phases of formulas
+       processed concurrently in batch mode are not mixed up. */
+    t->cpu -= read_clock(CLOCK_THREAD_CPUTIME_ID);
+}
+
+void
+qbce_phase_stop(PhaseTime *t) {
+    t->wall += read_clock(CLOCK_MONOTONIC);
+    t->cpu += read_clock(CLOCK_THREAD_CPUTIME_ID);
+}
+
+static void
+print_json_phase(FILE *out, const char *name, PhaseTime *t) {
+    fprintf(out, "    \"%s\": {\"wall\": %.6f, \"cpu\": %.6f}",
+            name, t->wall, t->cpu);
+}
+
+/* Print 'str' as JSON string, escaping quotes, backslashes and control
+   characters. */
+static void
+print_json_string(FILE *out, const char *str) {
+    fputc('"', out);
+    for (; *str; str++) {
+        unsigned char ch = *str;
+        if (ch == '"' || ch == '\\')
+            fprintf(out, "\\%c", ch);
+        else if (ch < 0x20)
+            fprintf(out, "\\u%04x", ch);
+        else
+            fputc(ch, out);
+    }
+    fputc('"', out);
+}
+
+/* Print statistics as one JSON object. The formula is named 'name'. */
+void
+qbce_print_stats_json(QBCEPrepro *qr, FILE *out, const char *name) {
+    QBCEStats *st = &qr->stats;
+    RoundStats total;
+    memset(&total, 0, sizeof(RoundStats));
+    RoundStats *r;
+    for (r = st->rounds.start; r < st->rounds.top; r++) {
+        total.candidate_checks += r->candidate_checks;
+        total.tautology_checks += r->tautology_checks;
+        total.literal_comparisons += r->literal_comparisons;
+    }
 
-    if (!getrusage(RUSAGE_SELF, &usage)) {
-        result += usage.ru_utime.tv_sec + 1e-6 * usage.ru_utime.tv_usec;
-        result += usage.ru_stime.tv_sec + 1e-6 * usage.ru_stime.tv_usec;
+    fprintf(out, "{\n  \"formula\": ");
+    print_json_string(out, name);
+    fprintf(out, ",\n  \"vars\": %u,\n  \"clauses\": %u,\n"
+            "  \"blocked\": %u,\n",
+            qr->pcnf.size_vars ? qr->pcnf.size_vars - 1 : 0,
+            qr->pcnf.clauses.cnt, qr->cnt_blocked_clauses);
+    fprintf(out, "  \"max_allocated_bytes\": %lu,\n",
+            (unsigned long) mm_max_allocated(qr->mm));
+    fprintf(out, "  \"mem_limit_reached\": %s,\n",
+            qr->mem_limit_reached ? "true" : "false");
+    fprintf(out, "  \"empty_clause\": %s,\n",
+            qr->empty_clause ? "true" : "false");
+    fprintf(out, "  \"duplicate_clauses\": %u,\n", st->duplicate_clauses);
+    fprintf(out, "  \"phases\": {\n");
+    print_json_phase(out, "parse", &st->parse);
+    fprintf(out, ",\n");
+    print_json_phase(out, "occurrences", &st->occurrences);
+    fprintf(out, ",\n");
+    print_json_phase(out, "qbce", &st->qbce);
+    fprintf(out, ",\n");
+    print_json_phase(out, "output", &st->output);
+    fprintf(out, "\n  },\n");
+    fprintf(out, "  \"candidate_checks\": %llu,\n"
+            "  \"tautology_checks\": %llu,\n"
+            "  \"literal_comparisons\": %llu,\n",
+            total.candidate_checks, total.tautology_checks,
+            total.literal_comparisons);
+    fprintf(out, "  \"stages\": [");
+    unsigned int i;
+    for (i = 0; i < qr->pipeline_len; i++) {
+        StageStats *ss = st->stages + qr->pipeline[i];
+        fprintf(out, "%s\n    {\"name\": \"%s\", \"runs\": %u, "
+                "\"changes\": %llu, \"wall\": %.6f, \"cpu\": %.6f}",
+                i ? "," : "", stage_names[qr->pipeline[i]], ss->runs,
+                ss->changes, ss->time.wall, ss->time.cpu);
     }
+    fprintf(out, "%s],\n", qr->pipeline_len ? "\n  " : "");
+    fprintf(out, "  \"rounds\": [");
+    for (r = st->rounds.start; r < st->rounds.top; r++)
+        fprintf(out, "%s\n    {\"wall\": %.6f, \"cpu\": %.6f, "
+                "\"candidate_checks\": %llu, \"tautology_checks\": %llu, "
+                "\"literal_comparisons\": %llu, \"blocked\": %u}",
+                r == st->rounds.start ? "" : ",", r->time.wall, r->time.cpu,
+                r->candidate_checks, r->tautology_checks,
+                r->literal_comparisons, r->blocked);
+    fprintf(out, "%s]\n}\n", EMPTY_STACK (st->rounds) ? "" : "\n  ");
+}
 
-    return result;
+/* Print the error message 'msg' processing the formula named 'name' as
+   JSON object, in place of its statistics. */
+void
+qbce_print_error_json(FILE *out, const char *name, const char *msg) {
+    fprintf(out, "{\n  \"formula\": ");
+    print_json_string(out, name);
+    fprintf(out, ",\n  \"error\": ");
+    print_json_string(out, msg);
+    fprintf(out, "\n}\n");
 }
 
 /* -------------------- END: HELPER FUNCTIONS -------------------- */
 
+/* -------------------- START: DEPENDENCY SCHEME -------------------- */
+
+/*
+ * Union-find forest over the clause IDs used to compute the dependency
+ * scheme. The root of each component keeps lists of the pending variables,
+ * that is, those without a dependency found yet, with a clause in the
+ * component, one for the existential and one for the universal ones. The
+ * lists are circular, such that two of them are joined in constant time:
+ * 'last[k][root]' is the last entry of list 'k' of 'root', or 0 if it is
+ * empty, and 'next' of the last entry is the first one.
+ */
+struct DepForest
+{
+    ClauseID *parent;
+    size_t *last[2];
+    VarID *entry_var;
+    size_t *next;
+    size_t num_entries;
+    /* Components a pending variable was added to, see 'add_pending'. */
+    VarID *stamps;
+};
+
+typedef struct DepForest DepForest;
+
+/* Index of the lists of variables of quantifier type @type. */
+#define DEP_LIST(type) ((type) == QTYPE_FORALL)
+
+/* Find the representative of clause @id, halving the path on the way. */
+static ClauseID
+find_component(DepForest *f, ClauseID id) {
+    while (f->parent[id] != id) {
+        f->parent[id] = f->parent[f->parent[id]];
+        id = f->parent[id];
+    }
+    return id;
+}
+
+/* Make @root the representative of the component of root @r, joining the
+   lists of @r to those of @root. */
+static void
+unite_components(DepForest *f, ClauseID r, ClauseID root) {
+    f->parent[r] = root;
+    int k;
+    for (k = 0; k < 2; k++) {
+        size_t a = f->last[k][root], b = f->last[k][r];
+        if (!b)
+            continue;
+        if (a) {
+            size_t first = f->next[a];
+            f->next[a] = f->next[b];
+            f->next[b] = first;
+        }
+        f->last[k][root] = b;
+        f->last[k][r] = 0;
+    }
+}
+
+/* Merge the components of the unblocked clauses in @occs. */
+static void
+unite_occurrences(DepForest *f, ClausePtrStack *occs, ClauseID *root) {
+    Clause **cp, **ce;
+    for (cp = occs->start, ce = occs->top; cp < ce; cp++) {
+        if ((*cp)->blocked)
+            continue;
+        ClauseID r = find_component(f, (*cp)->id);
+        if (!*root)
+            *root = r;
+        else if (r != *root)
+            unite_components(f, r, *root);
+    }
+}
+
+/* Append pending variable @y to list @k of root @r. */
+static void
+add_pending(DepForest *f, VarID y, int k, ClauseID r) {
+    size_t e = ++f->num_entries, last = f->last[k][r];
+    f->entry_var[e] = y;
+    if (last) {
+        f->next[e] = f->next[last];
+        f->next[last] = e;
+    } else
+        f->next[e] = e;
+    f->last[k][r] = e;
+}
+
+/* Add pending variable @y to lists @k of the components of its unblocked
+   clauses in @occs, once per component by stamping it with @y. */
+static void
+add_pending_occurrences(DepForest *f, VarID y, int k, ClausePtrStack *occs) {
+    Clause **cp, **ce;
+    for (cp = occs->start, ce = occs->top; cp < ce; cp++) {
+        if ((*cp)->blocked)
+            continue;
+        ClauseID r = find_component(f, (*cp)->id);
+        if (f->stamps[r] != y) {
+            f->stamps[r] = y;
+            add_pending(f, y, k, r);
+        }
+    }
+}
+
+/* Variables of the lists @k of the components of the unblocked clauses in
+   @occs depend on the level with nesting @stamp - 1. The lists are emptied,
+   as their variables are not pending any more. */
+static void
+resolve_pending(QBCEPrepro *qr, DepForest *f, int k, ClausePtrStack *occs,
+                unsigned int stamp) {
+    Clause **cp, **ce;
+    for (cp = occs->start, ce = occs->top; cp < ce; cp++) {
+        if ((*cp)->blocked)
+            continue;
+        ClauseID r = find_component(f, (*cp)->id);
+        size_t last = f->last[k][r], e = last;
+        if (!last)
+            continue;
+        do {
+            e = f->next[e];
+            if (!qr->dep_nesting[f->entry_var[e]])
+                qr->dep_nesting[f->entry_var[e]] = stamp;
+        } while (e != last);
+        f->last[k][r] = 0;
+    }
+}
+
+/*
+ * Compute the standard dependency scheme in the form needed by QBCE: for
+ * each variable y, the smallest nesting level 'dep_nesting[y]' it can be
+ * shifted to, which is one above the maximum nesting level of a variable y
+ * depends on, or 0 if there is none. Variable y depends on x if they have
+ * different quantifiers, x is to the left of y and they are connected by
+ * clauses sharing existential variables to the right of x. The scheme
+ * allows shifting y to the left of all variables it does not depend on
+ * (Samer and Szeider).
+ *
+ * The nesting levels are processed from right to left, adding the clauses
+ * of the existential variables of each level to a single union-find forest
+ * once the level is passed. The components keep lists of the variables to
+ * the right of the current level L without dependency found yet. Those of
+ * the other quantifier in a component with a clause of a variable of L
+ * depend on L, and the lists are emptied. Every variable enters a list at
+ * most once per occurrence and every entry is visited once, hence this
+ * takes almost linear time in the size of the formula, independently of
+ * the number of levels.
+ */
+static void
+compute_dependencies(QBCEPrepro *qr) {
+    Var *vars = qr->pcnf.vars;
+    size_t num_clauses = (size_t) qr->cur_clause_id + 1, num_occs = 0;
+    VarID v;
+    for (v = 1; v < qr->pcnf.size_vars; v++)
+        num_occs += COUNT_STACK(vars[v].pos_occ_clauses) +
+            COUNT_STACK(vars[v].neg_occ_clauses);
+
+    DepForest f;
+    memset(&f, 0, sizeof(DepForest));
+    f.parent = mm_malloc(qr->mm, num_clauses * sizeof(ClauseID));
+    int k;
+    for (k = 0; k < 2; k++)
+        f.last[k] = mm_malloc(qr->mm, num_clauses * sizeof(size_t));
+    f.entry_var = mm_malloc(qr->mm, (num_occs + 1) * sizeof(VarID));
+    f.next = mm_malloc(qr->mm, (num_occs + 1) * sizeof(size_t));
+    f.stamps = mm_malloc(qr->mm, num_clauses * sizeof(VarID));
+    qr->dep_nesting = mm_malloc(qr->mm, qr->pcnf.size_vars * sizeof(Nesting));
+    size_t i;
+    for (i = 0; i < num_clauses; i++)
+        f.parent[i] = i;
+
+    Scope *s;
+    for (s = qr->pcnf.scopes.last; s; s = s->link.prev) {
+        VarID *vp, *ve;
+        unsigned int stamp = s->nesting + 1;
+        int other = !DEP_LIST (s->type);
+        for (vp = s->vars.start, ve = s->vars.top; vp < ve; vp++) {
+            Var *x = VARID2VARPTR (vars, *vp);
+            resolve_pending(qr, &f, other, &x->pos_occ_clauses, stamp);
+            resolve_pending(qr, &f, other, &x->neg_occ_clauses, stamp);
+        }
+
+        /*
+         * The variables of 's' are to the right of the next level and become
+         * pending, where the existential ones connect their clauses to one
+         * component
+         */
+        for (vp = s->vars.start, ve = s->vars.top; vp < ve; vp++) {
+            Var *x = VARID2VARPTR (vars, *vp);
+            if (SCOPE_EXISTS (s)) {
+                ClauseID root = 0;
+                unite_occurrences(&f, &x->pos_occ_clauses, &root);
+                unite_occurrences(&f, &x->neg_occ_clauses, &root);
+                if (root)
+                    add_pending(&f, *vp, !other, root);
+            } else {
+                add_pending_occurrences(&f, *vp, !other, &x->pos_occ_clauses);
+                add_pending_occurrences(&f, *vp, !other, &x->neg_occ_clauses);
+            }
+        }
+    }
+
+    mm_free(qr->mm, f.stamps, num_clauses * sizeof(VarID));
+    mm_free(qr->mm, f.next, (num_occs + 1) * sizeof(size_t));
+    mm_free(qr->mm, f.entry_var, (num_occs + 1) * sizeof(VarID));
+    for (k = 0; k < 2; k++)
+        mm_free(qr->mm, f.last[k], num_clauses * sizeof(size_t));
+    mm_free(qr->mm, f.parent, num_clauses * sizeof(ClauseID));
+}
+
+/* Compute the dependency scheme before its first use if enabled. */
+static void
+prepare_dependencies(QBCEPrepro *qr) {
+    if (qr->options.dep_scheme && !qr->dep_nesting)
+        compute_dependencies(qr);
+}
+
+/*
+ * Return nonzero if a tautology on variable @y may be used to block a clause
+ * on a literal of variable @x, which requires @y to be quantified at most as
+ * deep as @x, or if a dependency scheme is used, that @y can be shifted
+ * there.
+ */
+static int
+may_block_on(QBCEPrepro *qr, VarID x, VarID y) {
+    Nesting nesting = qr->pcnf.vars[x].scope->nesting;
+    return qr->pcnf.vars[y].scope->nesting <= nesting ||
+        (qr->dep_nesting && qr->dep_nesting[y] <= nesting);
+}
+
+/* -------------------- END: DEPENDENCY SCHEME -------------------- */
+
 /* -------------------- START: QBCE -------------------- */
 
+/* Number of variables between checks whether a checkpoint is due. */
+#define CHECKPOINT_CHECK_VARS 1024
+
+/* Write a checkpoint if the checkpoint interval has passed since the last
+   one, or since QBCE started. */
+static void
+maybe_write_checkpoint(QBCEPrepro *qr) {
+    double now = read_clock(CLOCK_MONOTONIC);
+    if (!qr->last_checkpoint)
+        qr->last_checkpoint = now;
+    if (now - qr->last_checkpoint < qr->options.checkpoint_interval)
+        return;
+    if (!qbce_write_checkpoint(qr, qr->options.checkpoint))
+        fprintf(stderr, "could not write checkpoint '%s'\n",
+                qr->options.checkpoint);
+    else if (qr->options.verbosity >= 1)
+        fprintf(stderr, "wrote checkpoint with %u blocked clauses\n",
+                qr->cnt_blocked_clauses);
+    qr->last_checkpoint = read_clock(CLOCK_MONOTONIC);
+}
+
 /* Find and mark all blocked clauses. For blocked clauses 'c', the
    flag 'c->blocked' should be set to '1' (true). */
 static void
 find_and_mark_blocked_clauses(QBCEPrepro *qr) {
     Var *vars = qr->pcnf.vars;
     VarID sizeVar = qr->pcnf.size_vars;
+    prepare_dependencies(qr);
     /*
-     * For each variable of PCNF
+     * For each variable of PCNF (only once, later calls continue with the
+     * literals marked in the meantime, see 'qbce_add_clause')
      */
-    for(int i=0; i<sizeVar;i++){
+    for(int i=0; !qr->qbce_seeded && i<sizeVar;i++){
         /*
          * The blocking literals are being checked only for variables having existential scopes
          */
@@ -303,25 +637,56 @@ find_and_mark_blocked_clauses(QBCEPrepro *qr) {
             //VAR_NEG_MARK(vars[i]);
         }
     }
+    qr->qbce_seeded = 1;
     
-    /*
-     * The iterator variable, specifying the number of iterations
-     */
-    int iterator = 1;
     int blockedCount;
 
     /*
-     * Repeat, until there is no blocking literal in the formula
+     * Repeat, until there is no blocking literal in the formula. Each
+     * iteration is recorded as a round in the statistics.
      */
+    qbce_phase_start(&qr->stats.qbce);
     do {
-        blockedCount = findAndMarkBlockedClausesForMarkedVariables(qr);
         /*
-         * Uncoment to print number of blocked clauses in each iteration
+         * Stop early rather than running out of memory, keeping the clauses
+         * blocked so far (every prefix of the elimination is sound)
          */
-        //printf("There exist %d blocked clauses in iteration %d\n", blockedCount, iterator);
-        iterator++;
+        if (mm_limit_approached(qr->mm)) {
+            qr->mem_limit_reached = 1;
+            break;
+        }
+        RoundStats *round = &qr->stats.round;
+        memset(round, 0, sizeof(RoundStats));
+        qbce_phase_start(&round->time);
+        blockedCount = findAndMarkBlockedClausesForMarkedVariables(qr);
+        qbce_phase_stop(&round->time);
+        round->blocked = blockedCount;
+        PUSH_STACK (qr->mm, qr->stats.rounds, *round);
+        if (qr->options.verbosity >= 2)
+            fprintf(stderr, "There exist %d blocked clauses in iteration %u\n",
+                    blockedCount, (unsigned int) COUNT_STACK (qr->stats.rounds));
     } while (blockedCount > 0);
+    qbce_phase_stop(&qr->stats.qbce);
+
+}
+
 
+/*
+ * Count the occurrence lists of variable @x and their clauses as touched in
+ * external memory mode, once QBCE has checked a literal of @x. Counting per
+ * literal rather than per clause pair keeps the inner loops free of it.
+ */
+static void
+touch_occurrences(QBCEPrepro *qr, Var *x) {
+    ClausePtrStack *lists[2] = { &x->pos_occ_clauses, &x->neg_occ_clauses };
+    int k;
+    for (k = 0; k < 2; k++) {
+        Clause **cp, **ce;
+        for (cp = lists[k]->start, ce = lists[k]->top; cp < ce; cp++)
+            mm_external_touch(qr->mm, *cp, CLAUSE_BYTES (*cp));
+        mm_external_touch(qr->mm, lists[k]->start,
+                          COUNT_STACK (*lists[k]) * sizeof(Clause *));
+    }
 }
 
 
@@ -351,6 +716,13 @@ int findAndMarkBlockedClausesForMarkedVariables(QBCEPrepro *qr) {
          */
         int mark;
 
+        /*
+         * The blocked clauses and marks form a consistent state between
+         * variables, where a checkpoint may be written
+         */
+        if (qr->options.checkpoint && !(j % CHECKPOINT_CHECK_VARS))
+            maybe_write_checkpoint(qr);
+
         /*
          * If variable var[j].mark1 is true, the negative literal is considered
          */
@@ -421,6 +793,8 @@ int considerAndMark(QBCEPrepro * qr, VarID id, int isPosetive) {
         if (clause->blocked)
             continue;
 
+        qr->stats.round.candidate_checks++;
+
         /*
          * Call @isVariableBlockingInClause method to check whether the specified literal
          * in the specified clause is blocking
@@ -435,6 +809,7 @@ int considerAndMark(QBCEPrepro * qr, VarID id, int isPosetive) {
              * Blocking the clause
              */
             clause->blocked=1;
+            clause->blocking_lit = isPosetive ? -(LitID) id : (LitID) id;
 
             /*
              * Updating the total number of blocked clauses in the pcnf
@@ -480,6 +855,9 @@ int considerAndMark(QBCEPrepro * qr, VarID id, int isPosetive) {
     else
         vars[id].mark1=0;
 
+    if (qr->mm->ext_base)
+        touch_occurrences(qr, &vars[id]);
+
     return numberOfBlockedClauses;
 
 }
@@ -512,6 +890,8 @@ static int isVariableBlockingInClause(QBCEPrepro *qr, Clause *pClause, int varId
         if (clause->blocked)
             continue;
 
+        qr->stats.round.tautology_checks++;
+
         /*
          * The method @isVariableInCommon check whther tow clauses has common variable
          * considering nesting level restriction.
@@ -534,7 +914,8 @@ static int isVariableBlockingInClause(QBCEPrepro *qr, Clause *pClause, int varId
 /*
  * This method check whether two clause has common variables @x such that
  * - The sign of occurrences are opposite in two clauses
- * - The level of @x is not greater than the level of variable @id
+ * - The level of @x is not greater than the level of variable @id, or @x
+ *   does not depend on variables at the level of @id or deeper
  */
 static int isVariableInCommon(QBCEPrepro *qr, Clause *pClause, Clause *clause, int id) {
     /*
@@ -543,12 +924,11 @@ static int isVariableInCommon(QBCEPrepro *qr, Clause *pClause, Clause *clause, i
     unsigned int size1 = pClause->num_lits;
     int *vars1 = pClause->lits;
     unsigned int size2 = clause->num_lits;
-    //qdpll_get_nesting_of_var
+    LitID *vars2 = clause->lits;
     /*
-     * Fetching the level of variable @id
+     * Number of literal comparisons, added to the statistics once
      */
-    unsigned int nesting1 = qr->pcnf.vars[id].scope->nesting;
-    LitID *vars2 = clause->lits;
+    unsigned long long comparisons = 0;
 
     /*
      * Iterating over variables of first clause
@@ -556,10 +936,6 @@ static int isVariableInCommon(QBCEPrepro *qr, Clause *pClause, Clause *clause, i
     for (int i = 0; i < size1; i++) {
         int var1 = vars1[i];
 
-        /*
-         * Fetching the level of the considering variable
-         */
-        unsigned int nesting2 = qr->pcnf.vars[abs(var1)].scope->nesting;
         /*
          * Ignoring the occurrence of same variable
          */
@@ -567,9 +943,10 @@ static int isVariableInCommon(QBCEPrepro *qr, Clause *pClause, Clause *clause, i
             continue;
 
         /*
-         * Applying level restriction condition
+         * Applying level restriction condition, relaxed by the dependency
+         * scheme if enabled
          */
-        if(nesting2>nesting1)
+        if(!may_block_on(qr, id, abs(var1)))
             continue;
 
         /*
@@ -583,14 +960,18 @@ static int isVariableInCommon(QBCEPrepro *qr, Clause *pClause, Clause *clause, i
              * Checking the same variable and opposite sign
              * Returning true answer as soon as finding one
              */
-            if (var2 == -1 * var1)
+            if (var2 == -1 * var1) {
+                qr->stats.round.literal_comparisons += comparisons + j + 1;
                 return 1;
+            }
         }
+        comparisons += size2;
     }
 
     /*
      * In case of not finding such variable, the negative result is returned
      */
+    qr->stats.round.literal_comparisons += comparisons;
     return 0;
 }
 
@@ -609,81 +990,1502 @@ void printVariablesOfClause(const Clause *clause) {
 
 /* -------------------- END: QBCE -------------------- */
 
-/* --------------- START: DEMO CODE (DATA STRUCTURES) --------------- */
+/* -------------------- START: INCREMENTAL QBCE -------------------- */
 
+/*
+ * Schedule the literals of @clause for re-examination in the next call of
+ * 'find_and_mark_blocked_clauses'. If @ownLiterals is nonzero, the clauses
+ * containing the literals of @clause are re-examined (since @clause itself
+ * may be blocked now), otherwise the clauses containing their complements
+ * (since @clause is no partner of them anymore), like in 'considerAndMark'.
+ */
 static void
-demo_print_variables_occurrences(QBCEPrepro *qr, Var *var,
-                                 ClausePtrStack *clause_stack) {
-    fprintf(stderr, "Printing occurrences of variable %u\n", var->id);
-
-    /* Get pointer to stacks of (pointers) to clauses where variable 'var'
-       appears positively and negatively, respectively. */
-    ClausePtrStack *pos_occs = &(var->pos_occ_clauses);
-    ClausePtrStack *neg_occs = &(var->neg_occ_clauses);
+schedule_literal(QBCEPrepro *qr, LitID lit, int ownLiteral) {
+    Var *var = LIT2VARPTR (qr->pcnf.vars, lit);
+    if (!SCOPE_EXISTS (var->scope))
+        return;
+    if (LIT_POS (lit) == !ownLiteral)
+        var->mark0 = 1;
+    else
+        var->mark1 = 1;
+}
 
-    assert (EMPTY_STACK(*clause_stack));
+static void
+schedule_clause_literals(QBCEPrepro *qr, Clause *clause, int ownLiterals) {
+    LitID *p, *e;
+    for (p = clause->lits, e = p + clause->num_lits; p < e; p++)
+        schedule_literal(qr, *p, ownLiterals);
+}
 
-    /* Collect clauses where 'var' appears positively on stack 'clause_stack',
-       using flag 'mark' of clause objects to indicate if a clause object has
-       been pushed on the stack already (in this example, the use of 'mark' is
-       not necessary since variable can have at most one literal in a clause,
-       however, we show it for demonstration). */
-    Clause **cp, **ce;
-    for (cp = pos_occs->start, ce = pos_occs->top; cp < ce; cp++) {
-        Clause *c = *cp;
-        if (!c->mark) {
-            c->mark = 1;
-            PUSH_STACK (qr->mm, *clause_stack, c);
+/*
+ * Un-block all clauses whose blocking status depended on the absence of the
+ * new clause @clause. A clause blocked on literal 'l' stays blocked only if
+ * its resolvents on 'l' with all clauses containing '-l' are still
+ * tautological. Un-blocked clauses become part of the formula again, hence
+ * the check is repeated for them. The remaining blocked clauses, in their
+ * original order of elimination, are still blocked in the new formula.
+ */
+static void
+unblock_dependent_clauses(QBCEPrepro *qr, Clause *clause) {
+    ClausePtrStack added;
+    INIT_STACK (added);
+    PUSH_STACK (qr->mm, added, clause);
+
+    while (!EMPTY_STACK (added)) {
+        Clause *c = POP_STACK (added);
+        LitID *p, *e;
+        for (p = c->lits, e = p + c->num_lits; p < e; p++) {
+            Var *var = LIT2VARPTR (qr->pcnf.vars, *p);
+            if (!SCOPE_EXISTS (var->scope))
+                continue;
+            ClausePtrStack *occs = LIT_NEG (*p) ?
+                &var->pos_occ_clauses : &var->neg_occ_clauses;
+            Clause **cp, **ce;
+            for (cp = occs->start, ce = occs->top; cp < ce; cp++) {
+                Clause *d = *cp;
+                if (!d->blocked || d->blocking_lit != -*p)
+                    continue;
+                if (isVariableInCommon(qr, d, c, var->id))
+                    continue;
+                d->blocked = 0;
+                qr->cnt_blocked_clauses--;
+                schedule_clause_literals(qr, d, 1);
+                PUSH_STACK (qr->mm, added, d);
+            }
         }
     }
 
-    /* Same as above but for clause where 'var' appears negatively. */
-    for (cp = neg_occs->start, ce = neg_occs->top; cp < ce; cp++) {
-        Clause *c = *cp;
-        if (!c->mark) {
-            c->mark = 1;
-            PUSH_STACK (qr->mm, *clause_stack, c);
-        }
-    }
+    DELETE_STACK (qr->mm, added);
+}
 
-    /* Iterate over all clauses collected on 'clause_stack', reset mark and
-       print clause. */
-    for (cp = clause_stack->start, ce = clause_stack->top; cp < ce; cp++) {
-        Clause *c = *cp;
-        assert (c->mark);
-        c->mark = 0;
-        /* Print clause. */
-        fprintf(stderr, " Occ: ");
-        print_lits(qr, stderr, c->lits, c->num_lits, 0);
+/*
+ * Add a clause with the @num_lits literals in @lits to the formula. The
+ * clause and all clauses which were blocked only due to its absence are
+ * re-examined in the next call of 'qbce_find_blocked_clauses'.
+ */
+Clause *
+qbce_add_clause(QBCEPrepro *qr, LitID *lits, unsigned int num_lits) {
+    ABORT_APP (qr->dep_nesting,
+               "cannot add clauses after using the dependency scheme!\n");
+    ABORT_APP (qr->changed_stages & ~(1u << STAGE_QBCE),
+               "cannot add clauses after stages other than QBCE changed "
+               "the formula!\n");
+    /*
+     * 'import_clause' uses the variable marks to detect multiple literals of
+     * the same variable, hence pending marks are cleared beforehand. Both
+     * literals of each variable are scheduled again afterwards.
+     */
+    LitID *p, *e;
+    for (p = lits, e = p + num_lits; p < e; p++)
+        if (LIT2VARID (*p) < qr->pcnf.size_vars)
+            VAR_UNMARK (LIT2VARPTR (qr->pcnf.vars, *p));
+    Clause *clause = import_clause(qr, lits, num_lits);
+    /*
+     * Nothing is blocked yet and the first query considers all literals.
+     */
+    if (!qr->qbce_seeded)
+        return clause;
+    schedule_clause_literals(qr, clause, 0);
+    schedule_clause_literals(qr, clause, 1);
+    unblock_dependent_clauses(qr, clause);
+    return clause;
+}
 
-        /* Additionally, print all literals in the clause that are smaller than
-           'var' with respect to the prefix ordering. */
-        fprintf(stderr, "  Literals smaller than %u in prefix ordering: ", var->id);
-        LitID *lp, *le;
-        for (lp = c->lits, le = lp + c->num_lits; lp < le; lp++) {
-            LitID lit = *lp;
-            Var *other = LIT2VARPTR (qr->pcnf.vars, lit);
-            if (other->scope->nesting < var->scope->nesting)
-                fprintf(stderr, "%d ", lit);
-        }
-        fprintf(stderr, "0\n");
+/* Remove pointer to @clause from occurrence stack @occs, keeping the order. */
+static void
+remove_occurrence(ClausePtrStack *occs, Clause *clause) {
+    Clause **cp, **ce, **dp;
+    for (cp = dp = occs->start, ce = occs->top; cp < ce; cp++)
+        if (*cp != clause)
+            *dp++ = *cp;
+    assert (dp == occs->top - 1);
+    occs->top = dp;
+}
+
+/*
+ * Remove @clause from the formula and release it. The occurrence stacks of
+ * variable @skip are left untouched, which allows the caller to update them
+ * at once.
+ */
+static void
+delete_clause(QBCEPrepro *qr, Clause *clause, Var *skip) {
+    LitID *p, *e;
+    for (p = clause->lits, e = p + clause->num_lits; p < e; p++) {
+        Var *var = LIT2VARPTR (qr->pcnf.vars, *p);
+        if (var != skip)
+            remove_occurrence(LIT_NEG (*p) ? &var->neg_occ_clauses :
+                              &var->pos_occ_clauses, clause);
     }
 
-    RESET_STACK (*clause_stack);
-    assert (EMPTY_STACK(*clause_stack));
+    if (clause->blocked) {
+        qr->cnt_blocked_clauses--;
+        qr->cnt_extended_clauses -= clause->extended;
+    } else
+        schedule_clause_literals(qr, clause, 0);
+
+    UNLINK (qr->pcnf.clauses, clause, link);
+    mm_free(qr->mm, clause, CLAUSE_BYTES (clause));
 }
 
-/* This function is intended to demonstrate the data structures. It prints all
-   clauses where a particular variable appears in. */
+/*
+ * Un-block all clauses eliminated by QHBCE or QCBCE. Unlike clauses blocked
+ * by QBCE, they may have been eliminated due to the presence of other
+ * clauses: the binary clauses hidden literals were added by, the clauses
+ * covered literals were added by and the premises of ALA. These are not
+ * recorded, hence all eliminated clauses become part of the formula again,
+ * together with the clauses blocked only due to their absence.
+ */
 static void
-demo(QBCEPrepro *qr) {
-    /* Declare and initialize stack 'clause_stack' of pointers to clauses. */
-    ClausePtrStack clause_stack;
-    INIT_STACK (clause_stack);
-
-    /* Iterate over table of variable objects. */
-    Var *vp, *ve;
-    for (vp = qr->pcnf.vars, ve = vp + qr->pcnf.size_vars; vp < ve; vp++) {
+restore_extended_clauses(QBCEPrepro *qr) {
+    ClausePtrStack restored;
+    INIT_STACK (restored);
+    Clause *c;
+    for (c = qr->pcnf.clauses.first; c; c = c->link.next)
+        if (c->extended) {
+            c->blocked = c->extended = 0;
+            qr->cnt_blocked_clauses--;
+            qr->cnt_extended_clauses--;
+            PUSH_STACK (qr->mm, restored, c);
+        }
+    assert (!qr->cnt_extended_clauses);
+    /*
+     * Like in 'qbce_add_clause', nothing is blocked by QBCE before the first
+     * query
+     */
+    Clause **cp, **ce;
+    for (cp = restored.start, ce = restored.top; qr->qbce_seeded && cp < ce;
+         cp++) {
+        schedule_clause_literals(qr, *cp, 0);
+        schedule_clause_literals(qr, *cp, 1);
+        unblock_dependent_clauses(qr, *cp);
+    }
+    DELETE_STACK (qr->mm, restored);
+}
+
+/*
+ * Remove @clause from the formula and release it. Removing a clause never
+ * invalidates clauses blocked by QBCE, but clauses containing complements of
+ * its literals may become blocked in the next call of
+ * 'qbce_find_blocked_clauses'. Clauses eliminated by QHBCE or QCBCE may rely
+ * on @clause and are restored.
+ */
+void
+qbce_remove_clause(QBCEPrepro *qr, Clause *clause) {
+    ABORT_APP (qr->changed_stages & (1u << STAGE_SUB),
+               "cannot remove clauses after subsumption changed the "
+               "formula!\n");
+    /*
+     * Restored clauses may add dependencies, and may have to be simplified
+     * like the rest of the formula by the other stages
+     */
+    if (qr->cnt_extended_clauses) {
+        ABORT_APP (qr->dep_nesting, "cannot restore clauses after using "
+                   "the dependency scheme!\n");
+        ABORT_APP (qr->changed_stages & ~((1u << STAGE_QBCE) |
+                                          (1u << STAGE_QHBCE) |
+                                          (1u << STAGE_QCBCE)),
+                   "cannot restore clauses after stages other than QBCE, "
+                   "QHBCE and QCBCE changed the formula!\n");
+    }
+    delete_clause(qr, clause, 0);
+    if (qr->cnt_extended_clauses)
+        restore_extended_clauses(qr);
+}
+
+/*
+ * Compute the blocked clauses of the current formula and return their
+ * number. The first call considers all existential literals, later calls
+ * only the literals affected by clauses added or removed in the meantime.
+ */
+unsigned int
+qbce_find_blocked_clauses(QBCEPrepro *qr) {
+    find_and_mark_blocked_clauses(qr);
+    return qr->cnt_blocked_clauses;
+}
+
+/* -------------------- END: INCREMENTAL QBCE -------------------- */
+
+/* -------------------- START: HIDDEN AND COVERED QBCE -------------------- */
+
+/*
+ * A clause C is redundant if it is equivalent, w.r.t. the rest of the
+ * formula, to an extended clause C' which is blocked or tautological.
+ * C' is obtained by adding literals to C:
+ *  - hidden literal addition (HLA): for a literal 'k' of C' and a binary
+ *    clause (k m) other than C, add '-m'
+ *  - asymmetric literal addition (ALA, optional): for a clause D other than
+ *    C whose literals are all in C' except 'm', add '-m'
+ *  - covered literal addition (CLA): for an existential literal 'l' of C',
+ *    add the literals common to all clauses D containing '-l' whose outer
+ *    resolvent with C' on 'l' is not tautological, restricted to literals
+ *    quantified not to the right of 'l' (the outer part of D)
+ * Since C' may be blocked on an added literal, 'blocking_lit' of clauses
+ * eliminated here may not be a literal of the clause, or 0 if C' is
+ * tautological.
+ */
+
+/* Index of literal 'lit' in tables with two entries per variable. */
+#define LIT2IDX(lit) (2 * LIT2VARID (lit) + LIT_NEG (lit))
+
+/* Default maximum number of literal visits for extending one clause. */
+#define DEFAULT_EXT_EFFORT 10000
+
+/*
+ * State of QHBCE and QCBCE. The binary clauses containing literal 'lit' are
+ * 'bins[bin_start[LIT2IDX (lit)]]' to 'bins[bin_start[LIT2IDX (lit) + 1] - 1]'.
+ * The literals of the extended clause are kept on 'ext' and are flagged in
+ * 'in_ext'.
+ */
+struct ExtState
+{
+    QBCEPrepro *qr;
+    unsigned int *bin_start;
+    Clause **bins;
+    size_t num_bins;
+    unsigned char *in_ext;
+    /* Literal flags used for intersections in CLA. */
+    unsigned char *seen;
+    LitIDStack ext;
+    /* Candidates of CLA. */
+    LitIDStack common;
+    /* Literal visits spent on the current clause and their maximum. */
+    unsigned int steps;
+    unsigned int max_steps;
+    int covered;
+};
+
+typedef struct ExtState ExtState;
+
+static void
+init_ext_state(ExtState *st, QBCEPrepro *qr, int covered) {
+    memset(st, 0, sizeof(ExtState));
+    st->qr = qr;
+    st->covered = covered;
+    st->max_steps = qr->options.ext_effort ? qr->options.ext_effort :
+        DEFAULT_EXT_EFFORT;
+    size_t num_idx = 2 * (size_t) qr->pcnf.size_vars;
+    st->in_ext = mm_malloc(qr->mm, num_idx);
+    st->seen = mm_malloc(qr->mm, num_idx);
+
+    /*
+     * Count the binary clauses of each literal, turn the counts into end
+     * positions and fill the index from the back, which leaves the start
+     * positions
+     */
+    unsigned int *start = mm_malloc(qr->mm, (num_idx + 1) *
+                                    sizeof(unsigned int));
+    Clause *c;
+    for (c = qr->pcnf.clauses.first; c; c = c->link.next)
+        if (!c->blocked && c->num_lits == 2) {
+            start[LIT2IDX (c->lits[0])]++;
+            start[LIT2IDX (c->lits[1])]++;
+        }
+    size_t i, sum = 0;
+    for (i = 0; i < num_idx; i++) {
+        sum += start[i];
+        start[i] = sum;
+    }
+    start[num_idx] = sum;
+    st->num_bins = sum;
+    /* One extra entry such that the array is never empty. */
+    st->bins = mm_malloc(qr->mm, (sum + 1) * sizeof(Clause *));
+    for (c = qr->pcnf.clauses.first; c; c = c->link.next)
+        if (!c->blocked && c->num_lits == 2) {
+            st->bins[--start[LIT2IDX (c->lits[0])]] = c;
+            st->bins[--start[LIT2IDX (c->lits[1])]] = c;
+        }
+    st->bin_start = start;
+}
+
+static void
+delete_ext_state(ExtState *st) {
+    QBCEPrepro *qr = st->qr;
+    size_t num_idx = 2 * (size_t) qr->pcnf.size_vars;
+    mm_free(qr->mm, st->in_ext, num_idx);
+    mm_free(qr->mm, st->seen, num_idx);
+    mm_free(qr->mm, st->bin_start, (num_idx + 1) * sizeof(unsigned int));
+    mm_free(qr->mm, st->bins, (st->num_bins + 1) * sizeof(Clause *));
+    DELETE_STACK (qr->mm, st->ext);
+    DELETE_STACK (qr->mm, st->common);
+}
+
+/* Add @lit to the extended clause. Returns nonzero if the extended clause
+   becomes tautological. */
+static int
+add_ext_literal(ExtState *st, LitID lit) {
+    if (st->in_ext[LIT2IDX (-lit)])
+        return 1;
+    if (!st->in_ext[LIT2IDX (lit)]) {
+        st->in_ext[LIT2IDX (lit)] = 1;
+        PUSH_STACK (st->qr->mm, st->ext, lit);
+    }
+    return 0;
+}
+
+/*
+ * Asymmetric literal addition with the clauses containing @lit. Returns
+ * nonzero if the extended clause becomes tautological or contains one of
+ * these clauses, i.e. it is implied by the rest of the formula.
+ */
+static int
+asymmetric_literal_addition(ExtState *st, Clause *clause, LitID lit) {
+    Var *var = LIT2VARPTR (st->qr->pcnf.vars, lit);
+    ClausePtrStack *occs = LIT_NEG (lit) ? &var->neg_occ_clauses :
+        &var->pos_occ_clauses;
+    Clause **cp, **ce;
+    for (cp = occs->start, ce = occs->top; cp < ce; cp++) {
+        Clause *d = *cp;
+        if (d == clause || d->blocked || d->num_lits <= 2)
+            continue;
+        if ((st->steps += d->num_lits) > st->max_steps)
+            return 0;
+        LitID missing = 0;
+        LitID *p, *e;
+        for (p = d->lits, e = p + d->num_lits; p < e; p++)
+            if (!st->in_ext[LIT2IDX (*p)]) {
+                if (missing)
+                    break;
+                missing = *p;
+            }
+        if (p < e)
+            continue;
+        if (!missing || add_ext_literal(st, -missing))
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Hidden (and asymmetric) literal addition for the literals of the extended
+ * clause from position @*next on, until no literals are added. Returns
+ * nonzero if the extended clause becomes tautological.
+ */
+static int
+hidden_literal_addition(ExtState *st, Clause *clause, size_t *next) {
+    while (*next < COUNT_STACK (st->ext) && st->steps <= st->max_steps) {
+        LitID lit = st->ext.start[(*next)++];
+        unsigned int idx = LIT2IDX (lit), i;
+        for (i = st->bin_start[idx]; i < st->bin_start[idx + 1]; i++) {
+            Clause *b = st->bins[i];
+            if (++st->steps > st->max_steps)
+                return 0;
+            if (b == clause || b->blocked)
+                continue;
+            LitID other = b->lits[0] == lit ? b->lits[1] : b->lits[0];
+            if (add_ext_literal(st, -other))
+                return 1;
+        }
+        if (st->qr->options.ala &&
+            asymmetric_literal_addition(st, clause, lit))
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Return nonzero if the outer resolvent of the extended clause and @d on
+ * @lit is tautological, i.e. @d contains a literal quantified not to the
+ * right of @lit whose complement is in the extended clause.
+ */
+static int
+outer_resolvent_tautological(ExtState *st, Clause *d, LitID lit,
+                             Nesting nesting) {
+    Var *vars = st->qr->pcnf.vars;
+    LitID *p, *e;
+    for (p = d->lits, e = p + d->num_lits; p < e; p++)
+        if (*p != -lit && LIT2VARPTR (vars, *p)->scope->nesting <= nesting &&
+            st->in_ext[LIT2IDX (-*p)])
+            return 1;
+    return 0;
+}
+
+/*
+ * Check whether the extended clause is blocked on existential literal @lit.
+ * If not and @cover is nonzero, add the covered literals of @lit. Returns
+ * nonzero if the extended clause is blocked. Literals are added only if all
+ * clauses containing '-lit' were examined within the effort limit.
+ */
+static int
+blocked_or_covered(ExtState *st, Clause *clause, LitID lit, int cover) {
+    Var *vars = st->qr->pcnf.vars;
+    Nesting nesting = LIT2VARPTR (vars, lit)->scope->nesting;
+    Var *var = LIT2VARPTR (vars, lit);
+    ClausePtrStack *occs = LIT_NEG (lit) ? &var->pos_occ_clauses :
+        &var->neg_occ_clauses;
+    int first = 1;
+    RESET_STACK (st->common);
+
+    Clause **cp, **ce;
+    LitID *p, *e, *q;
+    for (cp = occs->start, ce = occs->top; cp < ce; cp++) {
+        Clause *d = *cp;
+        if (d == clause || d->blocked)
+            continue;
+        if ((st->steps += d->num_lits) > st->max_steps)
+            return 0;
+        if (outer_resolvent_tautological(st, d, lit, nesting))
+            continue;
+        if (!cover)
+            return 0;
+        if (first) {
+            first = 0;
+            for (p = d->lits, e = p + d->num_lits; p < e; p++)
+                if (*p != -lit && !st->in_ext[LIT2IDX (*p)] &&
+                    LIT2VARPTR (vars, *p)->scope->nesting <= nesting)
+                    PUSH_STACK (st->qr->mm, st->common, *p);
+        } else {
+            for (p = d->lits, e = p + d->num_lits; p < e; p++)
+                st->seen[LIT2IDX (*p)] = 1;
+            for (p = q = st->common.start, e = st->common.top; p < e; p++)
+                if (st->seen[LIT2IDX (*p)])
+                    *q++ = *p;
+            st->common.top = q;
+            for (p = d->lits, e = p + d->num_lits; p < e; p++)
+                st->seen[LIT2IDX (*p)] = 0;
+        }
+        if (EMPTY_STACK (st->common))
+            return 0;
+    }
+    if (first)
+        return 1;
+
+    /*
+     * The common literals are not complementary to the extended clause,
+     * since the outer resolvents are not tautological
+     */
+    for (p = st->common.start, e = st->common.top; p < e; p++) {
+        int taut = add_ext_literal(st, *p);
+        assert (!taut);
+    }
+    return 0;
+}
+
+/*
+ * Extend @clause and return nonzero if the extended clause is blocked or
+ * tautological. The literal the extended clause is blocked on, if any, is
+ * stored in @blockingLit.
+ */
+static int
+extended_clause_redundant(ExtState *st, Clause *clause, LitID *blockingLit) {
+    Var *vars = st->qr->pcnf.vars;
+    int redundant = 0;
+    size_t next = 0, i;
+    *blockingLit = 0;
+    st->steps = 0;
+    RESET_STACK (st->ext);
+    LitID *p, *e;
+    for (p = clause->lits, e = p + clause->num_lits; p < e; p++)
+        add_ext_literal(st, *p);
+
+    if (hidden_literal_addition(st, clause, &next)) {
+        redundant = 1;
+        goto done;
+    }
+
+    /*
+     * Without covered literal addition, the extended clause is only checked
+     * for being blocked on one of its literals. Otherwise, literals are
+     * added until no more are covered.
+     */
+    int added;
+    do {
+        size_t size = COUNT_STACK (st->ext);
+        for (i = 0; i < COUNT_STACK (st->ext); i++) {
+            LitID lit = st->ext.start[i];
+            if (!SCOPE_EXISTS (LIT2VARPTR (vars, lit)->scope))
+                continue;
+            if (blocked_or_covered(st, clause, lit, st->covered)) {
+                *blockingLit = lit;
+                redundant = 1;
+                goto done;
+            }
+            if (st->steps > st->max_steps)
+                goto done;
+        }
+        added = COUNT_STACK (st->ext) > size;
+        if (added && hidden_literal_addition(st, clause, &next)) {
+            redundant = 1;
+            goto done;
+        }
+    } while (added && st->steps <= st->max_steps);
+
+done:
+    for (p = st->ext.start, e = st->ext.top; p < e; p++)
+        st->in_ext[LIT2IDX (*p)] = 0;
+    return redundant;
+}
+
+/* Eliminate @clause if it is redundant after extension and push it on
+   @eliminated. */
+static void
+eliminate_if_redundant(ExtState *st, Clause *clause,
+                       ClausePtrStack *eliminated) {
+    QBCEPrepro *qr = st->qr;
+    LitID blockingLit;
+    if (!extended_clause_redundant(st, clause, &blockingLit))
+        return;
+    clause->blocked = 1;
+    clause->extended = 1;
+    clause->blocking_lit = blockingLit;
+    qr->cnt_blocked_clauses++;
+    qr->cnt_extended_clauses++;
+    schedule_clause_literals(qr, clause, 0);
+    PUSH_STACK (qr->mm, *eliminated, clause);
+}
+
+/*
+ * Eliminate clauses which are blocked or tautological after hidden (and
+ * covered, if @covered is nonzero) literal addition. After a first pass over
+ * all clauses, only the clauses which had an eliminated clause as resolution
+ * partner are examined again, until no more clauses are eliminated. Returns
+ * the number of eliminated clauses.
+ */
+static unsigned int
+eliminate_extended_blocked_clauses(QBCEPrepro *qr, int covered) {
+    ExtState st;
+    init_ext_state(&st, qr, covered);
+    ClausePtrStack eliminated, candidates;
+    INIT_STACK (eliminated);
+    INIT_STACK (candidates);
+    Clause *c;
+    for (c = qr->pcnf.clauses.first; c; c = c->link.next)
+        if (!c->blocked)
+            eliminate_if_redundant(&st, c, &eliminated);
+    unsigned int total = COUNT_STACK (eliminated);
+
+    while (!EMPTY_STACK (eliminated)) {
+        Clause **cp, **ce, **dp, **de;
+        for (cp = eliminated.start, ce = eliminated.top; cp < ce; cp++) {
+            LitID *p, *e;
+            for (p = (*cp)->lits, e = p + (*cp)->num_lits; p < e; p++) {
+                Var *var = LIT2VARPTR (qr->pcnf.vars, *p);
+                ClausePtrStack *occs = LIT_NEG (*p) ? &var->pos_occ_clauses :
+                    &var->neg_occ_clauses;
+                for (dp = occs->start, de = occs->top; dp < de; dp++)
+                    if (!(*dp)->blocked && !(*dp)->mark) {
+                        (*dp)->mark = 1;
+                        PUSH_STACK (qr->mm, candidates, *dp);
+                    }
+            }
+        }
+        RESET_STACK (eliminated);
+        for (cp = candidates.start, ce = candidates.top; cp < ce; cp++) {
+            (*cp)->mark = 0;
+            if (!(*cp)->blocked)
+                eliminate_if_redundant(&st, *cp, &eliminated);
+        }
+        RESET_STACK (candidates);
+        total += COUNT_STACK (eliminated);
+    }
+
+    DELETE_STACK (qr->mm, eliminated);
+    DELETE_STACK (qr->mm, candidates);
+    delete_ext_state(&st);
+    return total;
+}
+
+/* QHBCE as pipeline stage. Returns the number of eliminated clauses. */
+static unsigned int
+qhbce_stage(QBCEPrepro *qr) {
+    return eliminate_extended_blocked_clauses(qr, 0);
+}
+
+/* QCBCE as pipeline stage. Returns the number of eliminated clauses. */
+static unsigned int
+qcbce_stage(QBCEPrepro *qr) {
+    return eliminate_extended_blocked_clauses(qr, 1);
+}
+
+/* -------------------- END: HIDDEN AND COVERED QBCE -------------------- */
+
+/* -------------------- START: PIPELINE -------------------- */
+
+/*
+ * Move the clauses on occurrence stack @occs which are not blocked to stack
+ * @moved. Blocked clauses are considered removed from the formula by all
+ * stages and stay on @occs.
+ */
+static void
+move_unblocked_occurrences(QBCEPrepro *qr, ClausePtrStack *occs,
+                           ClausePtrStack *moved) {
+    Clause **cp, **ce, **dp;
+    for (cp = dp = occs->start, ce = occs->top; cp < ce; cp++)
+        if ((*cp)->blocked)
+            *dp++ = *cp;
+        else
+            PUSH_STACK (qr->mm, *moved, *cp);
+    occs->top = dp;
+}
+
+/* Return nonzero if some clause on occurrence stack @occs is not blocked. */
+static int
+has_unblocked_occurrence(ClausePtrStack *occs) {
+    Clause **cp, **ce;
+    for (cp = occs->start, ce = occs->top; cp < ce; cp++)
+        if (!(*cp)->blocked)
+            return 1;
+    return 0;
+}
+
+/*
+ * Remove literal @lit from @clause, keeping the order of the other literals.
+ * The clause is removed from the occurrence stack of @lit only if
+ * @updateOccs is nonzero. Clauses containing the complement of @lit may
+ * become blocked since @clause is no partner of them anymore.
+ */
+static void
+remove_literal(QBCEPrepro *qr, Clause *clause, LitID lit, int updateOccs) {
+    LitID *p, *e;
+    for (p = clause->lits, e = p + clause->num_lits; p < e && *p != lit; p++)
+        ;
+    assert (p < e);
+    for (p++; p < e; p++)
+        p[-1] = *p;
+    clause->num_lits--;
+    clause->num_removed_lits++;
+
+    if (updateOccs) {
+        Var *var = LIT2VARPTR (qr->pcnf.vars, lit);
+        remove_occurrence(LIT_NEG (lit) ? &var->neg_occ_clauses :
+                          &var->pos_occ_clauses, clause);
+    }
+    schedule_literal(qr, lit, 0);
+    if (!clause->num_lits)
+        qr->empty_clause = 1;
+}
+
+/* Return the literal of @clause if it is an existential unit clause which
+   is not blocked, otherwise 0. */
+static LitID
+existential_unit(QBCEPrepro *qr, Clause *clause) {
+    if (clause->blocked || clause->num_lits != 1)
+        return 0;
+    Var *var = LIT2VARPTR (qr->pcnf.vars, clause->lits[0]);
+    return SCOPE_EXISTS (var->scope) ? clause->lits[0] : 0;
+}
+
+/*
+ * Assign @lit to true: the clauses containing @lit are deleted and the
+ * complement of @lit is removed from all other clauses. If not null, the
+ * literals of new existential unit clauses are pushed on @units and the
+ * variables of deleted clauses on @touched. Returns nonzero if the formula
+ * changed.
+ */
+static int
+assign_literal(QBCEPrepro *qr, LitID lit, LitIDStack *units,
+               VarIDStack *touched) {
+    Var *var = LIT2VARPTR (qr->pcnf.vars, lit);
+    ClausePtrStack satisfied, falsified;
+    INIT_STACK (satisfied);
+    INIT_STACK (falsified);
+    /*
+     * The occurrences of the variable are updated at once here rather than
+     * by 'delete_clause' and 'remove_literal'.
+     */
+    move_unblocked_occurrences(qr, LIT_POS (lit) ? &var->pos_occ_clauses :
+                               &var->neg_occ_clauses, &satisfied);
+    move_unblocked_occurrences(qr, LIT_POS (lit) ? &var->neg_occ_clauses :
+                               &var->pos_occ_clauses, &falsified);
+    int changed = !EMPTY_STACK (satisfied) || !EMPTY_STACK (falsified);
+
+    Clause **cp, **ce;
+    for (cp = satisfied.start, ce = satisfied.top; cp < ce; cp++) {
+        Clause *c = *cp;
+        if (touched) {
+            LitID *p, *e;
+            for (p = c->lits, e = p + c->num_lits; p < e; p++)
+                if (LIT2VARPTR (qr->pcnf.vars, *p) != var)
+                    PUSH_STACK (qr->mm, *touched, LIT2VARID (*p));
+        }
+        delete_clause(qr, c, var);
+    }
+    for (cp = falsified.start, ce = falsified.top; cp < ce; cp++) {
+        remove_literal(qr, *cp, -lit, 0);
+        LitID unit = existential_unit(qr, *cp);
+        if (units && unit)
+            PUSH_STACK (qr->mm, *units, unit);
+    }
+
+    DELETE_STACK (qr->mm, satisfied);
+    DELETE_STACK (qr->mm, falsified);
+    return changed;
+}
+
+/*
+ * Universal reduction: remove the universal literals of a clause which are
+ * quantified to the right of all existential literals of the clause. All
+ * literals of a clause without existential literals are removed, which
+ * makes the formula false. Returns the number of removed literals.
+ */
+static unsigned int
+universal_reduction(QBCEPrepro *qr) {
+    Var *vars = qr->pcnf.vars;
+    unsigned int removed = 0;
+    Clause *c;
+    for (c = qr->pcnf.clauses.first; c && !qr->empty_clause;
+         c = c->link.next) {
+        if (c->blocked)
+            continue;
+        if (!c->num_lits)
+            qr->empty_clause = 1;
+        /*
+         * One above the maximum nesting level of existential literals, 0 if
+         * there are none
+         */
+        Nesting bound = 0;
+        LitID *p, *e;
+        for (p = c->lits, e = p + c->num_lits; p < e; p++) {
+            Scope *s = LIT2VARPTR (vars, *p)->scope;
+            if (SCOPE_EXISTS (s) && s->nesting >= bound)
+                bound = s->nesting + 1;
+        }
+        /*
+         * Iterate backwards since 'remove_literal' shifts the literals after
+         * the removed one
+         */
+        for (p = c->lits + c->num_lits; p-- > c->lits;) {
+            Scope *s = LIT2VARPTR (vars, *p)->scope;
+            if (SCOPE_FORALL (s) && s->nesting >= bound) {
+                remove_literal(qr, c, *p, 1);
+                removed++;
+            }
+        }
+    }
+    return removed;
+}
+
+/*
+ * Unit propagation: assign the literals of existential unit clauses, which
+ * may produce new unit clauses. Returns the number of propagated units.
+ */
+static unsigned int
+unit_propagation(QBCEPrepro *qr) {
+    LitIDStack units;
+    INIT_STACK (units);
+    Clause *c;
+    for (c = qr->pcnf.clauses.first; c; c = c->link.next) {
+        LitID unit = existential_unit(qr, c);
+        if (unit)
+            PUSH_STACK (qr->mm, units, unit);
+        else if (!c->blocked && !c->num_lits)
+            qr->empty_clause = 1;
+    }
+
+    /*
+     * A unit clause is deleted only by assigning its literal, which makes
+     * later assignments of the same literal no-ops
+     */
+    unsigned int propagated = 0;
+    while (!EMPTY_STACK (units) && !qr->empty_clause)
+        if (assign_literal(qr, POP_STACK (units), &units, 0))
+            propagated++;
+
+    DELETE_STACK (qr->mm, units);
+    return propagated;
+}
+
+/*
+ * Eliminate the pure literal of variable @id, if any: an existential pure
+ * literal is assigned to true and a universal one to false. Variables of
+ * deleted clauses may become pure and are pushed on @touched. Returns
+ * nonzero if the formula changed.
+ */
+static int
+eliminate_pure_literal(QBCEPrepro *qr, VarID id, VarIDStack *touched) {
+    Var *var = VARID2VARPTR (qr->pcnf.vars, id);
+    if (!var->scope)
+        return 0;
+    int pos = has_unblocked_occurrence(&var->pos_occ_clauses);
+    int neg = has_unblocked_occurrence(&var->neg_occ_clauses);
+    if (pos == neg)
+        return 0;
+    LitID lit = pos ? (LitID) id : -(LitID) id;
+    return assign_literal(qr, SCOPE_EXISTS (var->scope) ? lit : -lit, 0,
+                          touched);
+}
+
+/*
+ * Pure literal elimination for all variables, until no pure literals are
+ * left. Returns the number of eliminated pure literals.
+ */
+static unsigned int
+pure_literal_elimination(QBCEPrepro *qr) {
+    VarIDStack touched;
+    INIT_STACK (touched);
+    unsigned int eliminated = 0;
+    VarID id;
+    for (id = 1; id < qr->pcnf.size_vars && !qr->empty_clause; id++) {
+        eliminated += eliminate_pure_literal(qr, id, &touched);
+        while (!EMPTY_STACK (touched) && !qr->empty_clause)
+            eliminated += eliminate_pure_literal(qr, POP_STACK (touched),
+                                                 &touched);
+    }
+    DELETE_STACK (qr->mm, touched);
+    return eliminated;
+}
+
+/*
+ * Remove the blocked universal literals of @clause: a universal literal 'l'
+ * is blocked if the outer resolvents of @clause on 'l' with all clauses
+ * containing '-l' are tautological, which is the same check as for
+ * blocking existential literals. Clauses containing the complement of a
+ * removed literal are pushed on @touched. Returns the number of removed
+ * literals.
+ */
+static unsigned int
+remove_blocked_universal_literals(QBCEPrepro *qr, Clause *clause,
+                                  ClausePtrStack *touched) {
+    unsigned int removed = 0;
+    LitID *p;
+    /*
+     * Iterate backwards since 'remove_literal' shifts the literals after
+     * the removed one
+     */
+    for (p = clause->lits + clause->num_lits; p-- > clause->lits;) {
+        LitID lit = *p;
+        Var *var = LIT2VARPTR (qr->pcnf.vars, lit);
+        if (!SCOPE_FORALL (var->scope) ||
+            !isVariableBlockingInClause(qr, clause, var->id, LIT_NEG (lit)))
+            continue;
+        remove_literal(qr, clause, lit, 1);
+        removed++;
+        ClausePtrStack *occs = LIT_NEG (lit) ? &var->pos_occ_clauses :
+            &var->neg_occ_clauses;
+        Clause **cp, **ce;
+        for (cp = occs->start, ce = occs->top; cp < ce; cp++)
+            if (!(*cp)->blocked && !(*cp)->mark) {
+                (*cp)->mark = 1;
+                PUSH_STACK (qr->mm, *touched, *cp);
+            }
+    }
+    return removed;
+}
+
+/*
+ * Blocked literal elimination for universal literals, until no more are
+ * found. Removing a literal from a clause can only make the complementary
+ * literals in other clauses blocked, hence after a first pass only these
+ * clauses are examined again. Returns the number of removed literals.
+ */
+static unsigned int
+qble_stage(QBCEPrepro *qr) {
+    prepare_dependencies(qr);
+    ClausePtrStack touched, next;
+    INIT_STACK (touched);
+    INIT_STACK (next);
+    unsigned int removed = 0;
+    Clause *c;
+    for (c = qr->pcnf.clauses.first; c && !qr->empty_clause; c = c->link.next)
+        if (!c->blocked)
+            removed += remove_blocked_universal_literals(qr, c, &touched);
+
+    while (!EMPTY_STACK (touched) && !qr->empty_clause) {
+        Clause **cp, **ce;
+        for (cp = touched.start, ce = touched.top; cp < ce; cp++)
+            (*cp)->mark = 0;
+        for (cp = touched.start, ce = touched.top; cp < ce; cp++)
+            if (!qr->empty_clause)
+                removed += remove_blocked_universal_literals(qr, *cp, &next);
+        ClausePtrStack tmp = touched;
+        touched = next;
+        next = tmp;
+        RESET_STACK (next);
+    }
+
+    Clause **cp, **ce;
+    for (cp = touched.start, ce = touched.top; cp < ce; cp++)
+        (*cp)->mark = 0;
+    DELETE_STACK (qr->mm, touched);
+    DELETE_STACK (qr->mm, next);
+    return removed;
+}
+
+/* Variables with more occurrences of one sign are not eliminated by BVE. */
+#define BVE_MAX_OCCS 16
+
+/*
+ * Append the resolvent of @c and @d on the variable of @lit, where @lit is
+ * in @c and '-lit' in @d, to @buf, terminated by 0. The resolvent must not
+ * be tautological.
+ */
+static void
+push_resolvent(QBCEPrepro *qr, LitIDStack *buf, Clause *c, Clause *d,
+               LitID lit) {
+    LitID *p, *e, *q, *qe;
+    for (p = c->lits, e = p + c->num_lits; p < e; p++)
+        if (*p != lit)
+            PUSH_STACK (qr->mm, *buf, *p);
+    for (q = d->lits, qe = q + d->num_lits; q < qe; q++) {
+        if (*q == -lit)
+            continue;
+        for (p = c->lits; p < e && *p != *q; p++)
+            ;
+        if (p == e)
+            PUSH_STACK (qr->mm, *buf, *q);
+    }
+    PUSH_STACK (qr->mm, *buf, 0);
+}
+
+/*
+ * Number of literals of the resolvent of @c and @d on the variable of @lit,
+ * or -1 if it is tautological. Tautologies are detected like in QBCE, where
+ * the nesting restriction has no effect since @lit is innermost.
+ */
+static int
+resolvent_size(QBCEPrepro *qr, Clause *c, Clause *d, LitID lit) {
+    if (isVariableInCommon(qr, c, d, LIT2VARID (lit)))
+        return -1;
+    int size = c->num_lits + d->num_lits - 2;
+    LitID *p, *e, *q, *qe;
+    for (q = d->lits, qe = q + d->num_lits; q < qe; q++)
+        for (p = c->lits, e = p + c->num_lits; p < e; p++)
+            if (*p == *q)
+                size--;
+    return size;
+}
+
+/*
+ * Add the clause of the @num_lits literals in @lits, which are free of
+ * duplicates and complements, produced by a simplification. Like in
+ * 'qbce_add_clause', pending QBCE marks are cleared for 'import_clause' and
+ * both literals of each variable are scheduled again afterwards.
+ */
+static void
+add_derived_clause(QBCEPrepro *qr, LitID *lits, unsigned int num_lits) {
+    LitID *p, *e;
+    for (p = lits, e = p + num_lits; p < e; p++)
+        VAR_UNMARK (LIT2VARPTR (qr->pcnf.vars, *p));
+    Clause *clause = import_clause(qr, lits, num_lits);
+    schedule_clause_literals(qr, clause, 0);
+    schedule_clause_literals(qr, clause, 1);
+    if (!num_lits)
+        qr->empty_clause = 1;
+}
+
+/*
+ * Eliminate existential variable @var of the innermost scope by replacing
+ * the clauses containing it by their non-tautological resolvents on @var,
+ * provided that this increases the numbers of clauses and literals by at
+ * most the BVE bounds. Returns nonzero if @var was eliminated.
+ */
+static int
+eliminate_variable(QBCEPrepro *qr, Var *var, LitIDStack *buf) {
+    ClausePtrStack *pos = &var->pos_occ_clauses, *neg = &var->neg_occ_clauses;
+    if (COUNT_STACK (*pos) > BVE_MAX_OCCS || COUNT_STACK (*neg) > BVE_MAX_OCCS)
+        return 0;
+    if (!has_unblocked_occurrence(pos) && !has_unblocked_occurrence(neg))
+        return 0;
+
+    long clauses = qr->options.bve_clause_bound;
+    long lits = qr->options.bve_lit_bound;
+    Clause **cp, **ce, **dp, **de;
+    for (cp = pos->start, ce = pos->top; cp < ce; cp++)
+        if (!(*cp)->blocked) {
+            clauses++;
+            lits += (*cp)->num_lits;
+        }
+    for (dp = neg->start, de = neg->top; dp < de; dp++)
+        if (!(*dp)->blocked) {
+            clauses++;
+            lits += (*dp)->num_lits;
+        }
+
+    LitID lit = var->id;
+    RESET_STACK (*buf);
+    for (cp = pos->start, ce = pos->top; cp < ce; cp++) {
+        if ((*cp)->blocked)
+            continue;
+        for (dp = neg->start, de = neg->top; dp < de; dp++) {
+            if ((*dp)->blocked)
+                continue;
+            int size = resolvent_size(qr, *cp, *dp, lit);
+            if (size < 0)
+                continue;
+            if (--clauses < 0 || (lits -= size) < 0)
+                return 0;
+            push_resolvent(qr, buf, *cp, *dp, lit);
+        }
+    }
+
+    /*
+     * Delete the clauses containing @var, updating its occurrence stacks at
+     * once, and add the resolvents
+     */
+    ClausePtrStack deleted;
+    INIT_STACK (deleted);
+    move_unblocked_occurrences(qr, pos, &deleted);
+    move_unblocked_occurrences(qr, neg, &deleted);
+    for (cp = deleted.start, ce = deleted.top; cp < ce; cp++)
+        delete_clause(qr, *cp, var);
+    DELETE_STACK (qr->mm, deleted);
+
+    LitID *p, *e, *b;
+    for (p = buf->start, e = buf->top; p < e; p = b + 1) {
+        for (b = p; *b; b++)
+            ;
+        add_derived_clause(qr, p, b - p);
+    }
+    return 1;
+}
+
+/*
+ * Bounded variable elimination of the existential variables of the
+ * innermost scope, which is sound for Q-resolution without universal
+ * reduction. Eliminating a variable may enable others, hence the scope is
+ * examined until no more variables are eliminated. Returns the number of
+ * eliminated variables.
+ */
+static unsigned int
+bve_stage(QBCEPrepro *qr) {
+    Scope *scope = qr->pcnf.scopes.last;
+    if (!scope || !SCOPE_EXISTS (scope))
+        return 0;
+    LitIDStack buf;
+    INIT_STACK (buf);
+    unsigned int eliminated = 0, round;
+    do {
+        round = 0;
+        VarID *vp, *ve;
+        for (vp = scope->vars.start, ve = scope->vars.top;
+             vp < ve && !qr->empty_clause; vp++)
+            round += eliminate_variable(qr, VARID2VARPTR (qr->pcnf.vars, *vp),
+                                        &buf);
+        eliminated += round;
+    } while (round && !qr->empty_clause);
+    DELETE_STACK (qr->mm, buf);
+    return eliminated;
+}
+
+/* Signature of the variables of @clause, used to filter candidates for
+   subsumption and self-subsuming resolution. */
+static unsigned long long
+clause_signature(Clause *clause) {
+    unsigned long long sig = 0;
+    LitID *p, *e;
+    for (p = clause->lits, e = p + clause->num_lits; p < e; p++)
+        sig |= 1ULL << (LIT2VARID (*p) & 63);
+    return sig;
+}
+
+/* Order clauses by size and then by ID. */
+static int
+compare_clause_size(const void *a, const void *b) {
+    const Clause *c = *(Clause * const *) a, *d = *(Clause * const *) b;
+    if (c->num_lits != d->num_lits)
+        return c->num_lits < d->num_lits ? -1 : 1;
+    return c->id < d->id ? -1 : c->id > d->id;
+}
+
+/*
+ * Use @clause to remove the clauses it subsumes and to strengthen the
+ * clauses it self-subsumes, i.e. which contain the complement of one of its
+ * literals and all other literals. Every such clause contains the variable
+ * of @clause with the fewest occurrences, hence only the occurrences of this
+ * variable are examined, and only if their signatures fit. Variables of
+ * @clause are marked with their sign in @signs. Subsumed clauses are marked
+ * and pushed on @subsumed, strengthened clauses are pushed on @queue since
+ * they may subsume or strengthen other clauses now. Returns the number of
+ * subsumed and strengthened clauses.
+ */
+static unsigned int
+backward_subsume(QBCEPrepro *qr, Clause *clause, unsigned long long *sigs,
+                 signed char *signs, ClausePtrStack *queue,
+                 ClausePtrStack *subsumed) {
+    Var *vars = qr->pcnf.vars, *min = 0;
+    LitID *p, *e;
+    for (p = clause->lits, e = p + clause->num_lits; p < e; p++) {
+        Var *var = LIT2VARPTR (vars, *p);
+        signs[var->id] = LIT_NEG (*p) ? -1 : 1;
+        if (!min || COUNT_STACK (var->pos_occ_clauses) +
+            COUNT_STACK (var->neg_occ_clauses) <
+            COUNT_STACK (min->pos_occ_clauses) +
+            COUNT_STACK (min->neg_occ_clauses))
+            min = var;
+    }
+
+    /*
+     * Strengthening a clause removes it from an occurrence stack, hence the
+     * strengthened clauses are collected first
+     */
+    ClausePtrStack strengthened;
+    LitIDStack removed_lits;
+    INIT_STACK (strengthened);
+    INIT_STACK (removed_lits);
+    unsigned long long sig = sigs[clause->id];
+    unsigned int changes = 0;
+    ClausePtrStack *occs[2] = { &min->pos_occ_clauses, &min->neg_occ_clauses };
+    int i;
+    for (i = 0; i < 2; i++) {
+        Clause **dp, **de;
+        for (dp = occs[i]->start, de = occs[i]->top; dp < de; dp++) {
+            Clause *d = *dp;
+            if (d == clause || d->blocked || d->mark ||
+                d->num_lits < clause->num_lits || (sig & ~sigs[d->id]))
+                continue;
+            unsigned int same = 0, complements = 0;
+            LitID complement = 0;
+            LitID *q, *qe;
+            for (q = d->lits, qe = q + d->num_lits; q < qe; q++) {
+                int sign = signs[LIT2VARID (*q)];
+                if (!sign)
+                    continue;
+                if ((sign < 0) == (LIT_NEG (*q) != 0)) {
+                    same++;
+                } else if (complements++) {
+                    break;
+                } else {
+                    complement = *q;
+                }
+            }
+            if (complements > 1)
+                continue;
+            if (!complements && same == clause->num_lits) {
+                d->mark = 1;
+                PUSH_STACK (qr->mm, *subsumed, d);
+                changes++;
+            } else if (complements && same + 1 == clause->num_lits) {
+                PUSH_STACK (qr->mm, strengthened, d);
+                PUSH_STACK (qr->mm, removed_lits, complement);
+            }
+        }
+    }
+    for (p = clause->lits, e = p + clause->num_lits; p < e; p++)
+        signs[LIT2VARID (*p)] = 0;
+
+    Clause **dp, **de;
+    for (dp = strengthened.start, de = strengthened.top; dp < de; dp++) {
+        Clause *d = *dp;
+        remove_literal(qr, d, removed_lits.start[dp - strengthened.start], 1);
+        sigs[d->id] = clause_signature(d);
+        PUSH_STACK (qr->mm, *queue, d);
+        changes++;
+    }
+    DELETE_STACK (qr->mm, strengthened);
+    DELETE_STACK (qr->mm, removed_lits);
+    return changes;
+}
+
+/*
+ * Subsumption and self-subsuming resolution, both of which are sound for
+ * any quantifier of the literals involved. All clauses are used for
+ * backward subsumption in the order of their sizes. Since strengthening
+ * only shrinks clauses, a clause cannot become subsumed by a clause it was
+ * already checked against, which makes forward checks unnecessary once the
+ * strengthened clauses are checked again. Subsumed clauses are deleted at
+ * the end. Returns the number of subsumed and strengthened clauses.
+ */
+static unsigned int
+subsumption_stage(QBCEPrepro *qr) {
+    size_t num_sigs = (size_t) qr->cur_clause_id + 1;
+    unsigned long long *sigs = mm_malloc(qr->mm, num_sigs * sizeof(*sigs));
+    signed char *signs = mm_malloc(qr->mm, qr->pcnf.size_vars);
+    ClausePtrStack queue, subsumed;
+    INIT_STACK (queue);
+    INIT_STACK (subsumed);
+    Clause *c;
+    for (c = qr->pcnf.clauses.first; c; c = c->link.next)
+        if (!c->blocked) {
+            sigs[c->id] = clause_signature(c);
+            PUSH_STACK (qr->mm, queue, c);
+        }
+    if (!EMPTY_STACK (queue))
+        qsort(queue.start, COUNT_STACK (queue), sizeof(Clause *),
+              compare_clause_size);
+
+    unsigned int changes = 0;
+    size_t i;
+    for (i = 0; i < COUNT_STACK (queue) && !qr->empty_clause; i++) {
+        c = queue.start[i];
+        if (!c->mark && c->num_lits)
+            changes += backward_subsume(qr, c, sigs, signs, &queue,
+                                        &subsumed);
+    }
+
+    Clause **cp, **ce;
+    for (cp = subsumed.start, ce = subsumed.top; cp < ce; cp++)
+        delete_clause(qr, *cp, 0);
+    DELETE_STACK (qr->mm, queue);
+    DELETE_STACK (qr->mm, subsumed);
+    mm_free(qr->mm, signs, qr->pcnf.size_vars);
+    mm_free(qr->mm, sigs, num_sigs * sizeof(*sigs));
+    return changes;
+}
+
+/* QBCE as pipeline stage. Returns the number of newly blocked clauses. */
+static unsigned int
+qbce_stage(QBCEPrepro *qr) {
+    unsigned int blocked = qr->cnt_blocked_clauses;
+    find_and_mark_blocked_clauses(qr);
+    return qr->cnt_blocked_clauses - blocked;
+}
+
+/* Stage functions, indexed by 'PipelineStage'. Each stage leaves the
+   formula at a fixed point of its own technique. */
+static unsigned int (*const stage_funcs[NUM_STAGES]) (QBCEPrepro *) = {
+    universal_reduction, unit_propagation, pure_literal_elimination,
+    qbce_stage, qhbce_stage, qcbce_stage, qble_stage, bve_stage,
+    subsumption_stage
+};
+
+int
+qbce_set_pipeline(QBCEPrepro *qr, const char *spec) {
+    unsigned int len = 0, seen = 0, i;
+    const char *p = spec;
+    while (*p) {
+        size_t n = strcspn(p, ",");
+        for (i = 0; i < NUM_STAGES; i++)
+            if (strlen(stage_names[i]) == n && !strncmp(p, stage_names[i], n))
+                break;
+        if (i == NUM_STAGES || (seen & (1u << i)))
+            return 0;
+        seen |= 1u << i;
+        qr->pipeline[len++] = (PipelineStage) i;
+        p += n;
+        if (*p == ',' && !*++p)
+            return 0;
+    }
+    if (!len)
+        return 0;
+    qr->pipeline_len = len;
+    return 1;
+}
+
+const char *
+qbce_stage_name(PipelineStage stage) {
+    return stage_names[stage];
+}
+
+unsigned int
+qbce_simplify(QBCEPrepro *qr) {
+    if (!qr->pipeline_len) {
+        qr->pipeline[0] = STAGE_QBCE;
+        qr->pipeline_len = 1;
+    }
+    /*
+     * Since each stage reaches its own fixed point, the joint fixed point is
+     * reached once all stages in a row did not change the formula
+     */
+    unsigned int i = 0, idle = 0;
+    while (idle < qr->pipeline_len && !qr->empty_clause &&
+           !qr->mem_limit_reached) {
+        PipelineStage stage = qr->pipeline[i];
+        StageStats *ss = qr->stats.stages + stage;
+        qbce_phase_start(&ss->time);
+        unsigned int changes = stage_funcs[stage](qr);
+        qbce_phase_stop(&ss->time);
+        ss->runs++;
+        ss->changes += changes;
+        if (changes)
+            qr->changed_stages |= 1u << stage;
+        if (qr->options.verbosity >= 2)
+            fprintf(stderr, "Stage %s: %u changes\n", stage_names[stage],
+                    changes);
+        idle = changes ? 1 : idle + 1;
+        i = (i + 1) % qr->pipeline_len;
+    }
+    return qbce_num_surviving_clauses(qr);
+}
+
+/* -------------------- END: PIPELINE -------------------- */
+
+/* -------------------- START: LIBRARY INTERFACE -------------------- */
+
+/*
+ * Create a new preprocessor object with its own memory manager. Objects do
+ * not share any state, hence several of them can be used in one process.
+ */
+QBCEPrepro *
+qbce_create(void) {
+    QBCEPrepro *qr = (QBCEPrepro *) malloc(sizeof(QBCEPrepro));
+    ABORT_APP (!qr, "could not allocate memory!");
+    memset(qr, 0, sizeof(QBCEPrepro));
+    qr->mm = mm_create();
+    qr->options.in = stdin;
+    return qr;
+}
+
+/* Release all memory of @qr, including @qr itself. */
+void
+qbce_delete(QBCEPrepro *qr) {
+    cleanup(qr);
+    mm_delete(qr->mm);
+    free(qr);
+}
+
+/* Release the formula of @qr but keep its options, pipeline and memory
+   manager, whose pooled blocks are reused by the next formula. */
+void
+qbce_reset(QBCEPrepro *qr) {
+    cleanup(qr);
+    QBCEPrepro kept = *qr;
+    memset(qr, 0, sizeof(QBCEPrepro));
+    qr->mm = kept.mm;
+    qr->options = kept.options;
+    memcpy(qr->pipeline, kept.pipeline, sizeof(qr->pipeline));
+    qr->pipeline_len = kept.pipeline_len;
+    mm_reset_max_allocated(qr->mm);
+}
+
+/*
+ * Release the formula of @qr after an error was recovered from (see
+ * 'error.h'), like 'qbce_reset'. Temporary blocks of the operation that
+ * failed are written off.
+ */
+void
+qbce_recover(QBCEPrepro *qr) {
+    qbce_reset(qr);
+    mm_write_off(qr->mm);
+}
+
+/*
+ * Allocate the table of variables with IDs from 1 to @max_var_id. Must be
+ * called exactly once before scopes and clauses are added.
+ */
+void
+qbce_declare_vars(QBCEPrepro *qr, VarID max_var_id) {
+    ABORT_APP (qr->pcnf.vars, "variables already declared!");
+    set_up_var_table(qr, max_var_id);
+}
+
+/*
+ * Append a new scope of type @type holding the @num_vars variable IDs in
+ * @vars to the quantifier prefix.
+ */
+void
+qbce_add_scope(QBCEPrepro *qr, QuantifierType type, LitID *vars,
+               unsigned int num_vars) {
+    ABORT_APP (type != QTYPE_EXISTS && type != QTYPE_FORALL,
+               "invalid quantifier type!");
+    import_scope(qr, type, vars, num_vars);
+}
+
+/*
+ * Build the formula from in-memory arrays without any text round-trip. The
+ * arrays are encoded like the body of a QDIMACS file: @prefix holds for each
+ * scope its quantifier type (QTYPE_EXISTS or QTYPE_FORALL) followed by the
+ * variable IDs of the scope and a terminating 0, and @clauses holds the
+ * literals of each clause followed by a terminating 0.
+ */
+void
+qbce_import_formula(QBCEPrepro *qr, VarID max_var_id,
+                    LitID *prefix, size_t prefix_len,
+                    LitID *clauses, size_t clauses_len) {
+    LitID *p, *b, *e;
+    qbce_declare_vars(qr, max_var_id);
+
+    for (p = prefix, e = p + prefix_len; p < e; p = b + 1) {
+        QuantifierType type = (QuantifierType) *p;
+        for (b = p + 1; b < e && *b; b++)
+            ;
+        ABORT_APP (b == e, "scope in prefix not terminated by 0!");
+        qbce_add_scope(qr, type, p + 1, b - (p + 1));
+    }
+
+    for (p = clauses, e = p + clauses_len; p < e; p = b + 1) {
+        for (b = p; b < e && *b; b++)
+            ;
+        ABORT_APP (b == e, "clause not terminated by 0!");
+        import_clause(qr, p, b - p);
+    }
+}
+
+/* Return the number of clauses which are not blocked. */
+unsigned int
+qbce_num_surviving_clauses(QBCEPrepro *qr) {
+    assert (qr->pcnf.clauses.cnt >= qr->cnt_blocked_clauses);
+    return qr->pcnf.clauses.cnt - qr->cnt_blocked_clauses;
+}
+
+/*
+ * Write the IDs of all clauses which are not blocked to @ids in the order of
+ * the formula. Clauses are numbered from 1 in the order they were added.
+ * The array @ids must hold 'qbce_num_surviving_clauses' elements.
+ */
+void
+qbce_get_surviving_clause_ids(QBCEPrepro *qr, ClauseID *ids) {
+    Clause *c;
+    for (c = qr->pcnf.clauses.first; c; c = c->link.next)
+        if (!c->blocked)
+            *ids++ = c->id;
+}
+
+/* -------------------- END: LIBRARY INTERFACE -------------------- */
+
+/* --------------- START: DEMO CODE (DATA STRUCTURES) --------------- */
+
+static void
+demo_print_variables_occurrences(QBCEPrepro *qr, Var *var,
+                                 ClausePtrStack *clause_stack) {
+    fprintf(stderr, "Printing occurrences of variable %u\n", var->id);
+
+    /* Get pointer to stacks of (pointers) to clauses where variable 'var'
+       appears positively and negatively, respectively. */
+    ClausePtrStack *pos_occs = &(var->pos_occ_clauses);
+    ClausePtrStack *neg_occs = &(var->neg_occ_clauses);
+
+    assert (EMPTY_STACK(*clause_stack));
+
+    /* Collect clauses where 'var' appears positively on stack 'clause_stack',
+       using flag 'mark' of clause objects to indicate if a clause object has
+       been pushed on the stack already (in this example, the use of 'mark' is
+       not necessary since variable can have at most one literal in a clause,
+       however, we show it for demonstration). */
+    Clause **cp, **ce;
+    for (cp = pos_occs->start, ce = pos_occs->top; cp < ce; cp++) {
+        Clause *c = *cp;
+        if (!c->mark) {
+            c->mark = 1;
+            PUSH_STACK (qr->mm, *clause_stack, c);
+        }
+    }
+
+    /* Same as above but for clause where 'var' appears negatively. */
+    for (cp = neg_occs->start, ce = neg_occs->top; cp < ce; cp++) {
+        Clause *c = *cp;
+        if (!c->mark) {
+            c->mark = 1;
+            PUSH_STACK (qr->mm, *clause_stack, c);
+        }
+    }
+
+    /* Iterate over all clauses collected on 'clause_stack', reset mark and
+       print clause. */
+    for (cp = clause_stack->start, ce = clause_stack->top; cp < ce; cp++) {
+        Clause *c = *cp;
+        assert (c->mark);
+        c->mark = 0;
+        /* Print clause. */
+        fprintf(stderr, " Occ: ");
+        print_lits(qr, stderr, c->lits, c->num_lits, 0);
+
+        /* Additionally, print all literals in the clause that are smaller than
+           'var' with respect to the prefix ordering. */
+        fprintf(stderr, "  Literals smaller than %u in prefix ordering: ", var->id);
+        LitID *lp, *le;
+        for (lp = c->lits, le = lp + c->num_lits; lp < le; lp++) {
+            LitID lit = *lp;
+            Var *other = LIT2VARPTR (qr->pcnf.vars, lit);
+            if (other->scope->nesting < var->scope->nesting)
+                fprintf(stderr, "%d ", lit);
+        }
+        fprintf(stderr, "0\n");
+    }
+
+    RESET_STACK (*clause_stack);
+    assert (EMPTY_STACK(*clause_stack));
+}
+
+/* This function is intended to demonstrate the data structures. It prints all
+   clauses where a particular variable appears in. */
+static void
+demo(QBCEPrepro *qr) {
+    /* Declare and initialize stack 'clause_stack' of pointers to clauses. */
+    ClausePtrStack clause_stack;
+    INIT_STACK (clause_stack);
+
+    /* Iterate over table of variable objects. */
+    Var *vp, *ve;
+    for (vp = qr->pcnf.vars, ve = vp + qr->pcnf.size_vars; vp < ve; vp++) {
         /* Consider only variable objects which correspond to variables that
            actually appear in the formula. This is done by checking whether the
            variable ID is nonzero. */
@@ -698,71 +2500,3 @@ demo(QBCEPrepro *qr) {
 /* --------------- end: DEMO CODE (DATA STRUCTURES) --------------- */
 
 
-int
-main(int argc, char **argv) {
-    double start_time = time_stamp();
-    int result = 0;
-    /* Initialize QBCEPrepro object. */
-    QBCEPrepro qr;
-    memset(&qr, 0, sizeof(QBCEPrepro));
-    qr.start_time = start_time;
-    /* Initialize simple memory manager. */
-    MemMan *mm = mm_create();
-    qr.mm = mm;
-    set_default_options(&qr);
-
-    parse_cmd_line_options(&qr, argc, argv);
-
-    set_signal_handlers();
-
-    if (qr.options.print_usage) {
-        print_usage();
-        cleanup(&qr);
-        return result;
-    }
-
-    if (qr.options.max_time) {
-        fprintf(stderr, "Setting run time limit of %d seconds\n",
-                qr.options.max_time);
-        alarm(qr.options.max_time);
-    }
-
-    /* Parse QDIMACS formula and simplify, if appropriate command line options
-       are given. */
-    parse(&qr, qr.options.in);
-    ABORT_APP (qr.declared_num_clauses > qr.cur_clause_id,
-               "declared number of clauses exceeds actual number of clauses!");
-
-    // Function 'demo' illustrates the use of data structures
-    //  demo(&qr);
-
-    find_and_mark_blocked_clauses(&qr);
-
-    /* Print formula to stdout. */
-    if (qr.options.print_formula)
-        print_formula(&qr, stdout);
-
-    if (qr.options.verbosity >= 1) {
-        /* Print statistics. */
-        fprintf(stderr, "\nDONE, printing statistics:\n");
-        if (!qr.options.max_time)
-            fprintf(stderr, "  time limit: not set\n");
-        else
-            fprintf(stderr, "  time limit: %d\n", qr.options.max_time);
-        fprintf(stderr, "  simplification enabled: %s\n",
-                qr.options.simplify ? "yes" : "no");
-        fprintf(stderr, "  printing formula: %s\n",
-                qr.options.print_formula ? "yes" : "no");
-        fprintf(stderr, "  QBCE: %d blocked clauses of total %d clauses ( %f %% of initial CNF)\n",
-                qr.cnt_blocked_clauses, qr.declared_num_clauses, qr.declared_num_clauses ?
-                                                                 ((qr.cnt_blocked_clauses /
-                                                                   (float) qr.declared_num_clauses) * 100) : 0);
-        fprintf(stderr, "  run time: %f\n", time_stamp() - qr.start_time);
-    }
-
-    /* Clean up, free memory and exit. */
-    cleanup(&qr);
-    mm_delete(qr.mm);
-
-    return result;
-}
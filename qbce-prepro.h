@@ -21,8 +21,114 @@
 #ifndef QBCE_PREPRO_H_INCLUDED
 #define QBCE_PREPRO_H_INCLUDED
 
+#include <stdio.h>
 #include "pcnf.h"
 
+/* Wall clock and CPU time in seconds spent in a phase. Times accumulate if
+   a phase is run several times, e.g. by incremental queries. */
+struct PhaseTime
+{
+  double wall;
+  double cpu;
+};
+
+typedef struct PhaseTime PhaseTime;
+
+/* Counters of one round of QBCE. */
+struct RoundStats
+{
+  PhaseTime time;
+  /* Number of clauses checked for being blocked on a literal. */
+  unsigned long long candidate_checks;
+  /* Number of resolvents checked for being tautological. */
+  unsigned long long tautology_checks;
+  /* Number of pairs of literals compared in tautology checks. */
+  unsigned long long literal_comparisons;
+  /* Number of clauses found blocked in the round. */
+  unsigned int blocked;
+};
+
+typedef struct RoundStats RoundStats;
+
+DECLARE_STACK (RoundStats, RoundStats);
+
+/* Stages of the preprocessing pipeline, see 'qbce_set_pipeline'. */
+enum PipelineStage
+{
+  /* Universal reduction. */
+  STAGE_UR,
+  /* Propagation of existential unit clauses. */
+  STAGE_UP,
+  /* Elimination of pure literals. */
+  STAGE_PURE,
+  /* Quantified blocked clause elimination. */
+  STAGE_QBCE,
+  /* QBCE of clauses extended by hidden literal addition. */
+  STAGE_QHBCE,
+  /* QBCE of clauses extended by hidden and covered literal addition. */
+  STAGE_QCBCE,
+  /* Elimination of blocked universal literals. */
+  STAGE_QBLE,
+  /* Bounded variable elimination of innermost existential variables. */
+  STAGE_BVE,
+  /* Subsumption and self-subsuming resolution. */
+  STAGE_SUB,
+  NUM_STAGES
+};
+
+typedef enum PipelineStage PipelineStage;
+
+/* Statistics of a pipeline stage. The meaning of 'changes' depends on the
+   stage: removed universal literals, propagated units, eliminated pure
+   literals, blocked clauses, blocked universal literals, eliminated
+   variables and subsumed or strengthened clauses, respectively. */
+struct StageStats
+{
+  PhaseTime time;
+  unsigned int runs;
+  unsigned long long changes;
+};
+
+typedef struct StageStats StageStats;
+
+/* Performance statistics, written by '--stats-json'. */
+struct QBCEStats
+{
+  PhaseTime parse;
+  PhaseTime occurrences;
+  PhaseTime qbce;
+  PhaseTime output;
+  /* Statistics of all QBCE rounds. Counters of the current round are
+     collected in 'round' and pushed when the round is finished. */
+  RoundStatsStack rounds;
+  RoundStats round;
+  /* Statistics of the stages run by 'qbce_simplify'. */
+  StageStats stages[NUM_STAGES];
+  /* Number of parsed clauses dropped as duplicates. */
+  unsigned int duplicate_clauses;
+};
+
+typedef struct QBCEStats QBCEStats;
+
+/* Entry of the hash set of parsed clauses used to drop duplicates. */
+struct ClauseSetEntry
+{
+  Clause *clause;
+  unsigned int hash;
+};
+
+typedef struct ClauseSetEntry ClauseSetEntry;
+
+/* Entry of the hash map from the IDs of the variables declared in the
+   prefix to their compacted IDs. Empty entries have 'orig' zero. */
+struct VarMapEntry
+{
+  VarID orig;
+  VarID id;
+};
+
+typedef struct VarMapEntry VarMapEntry;
+
 /* QBCEPrepro object. This is used by the main application. */
 struct QBCEPrepro
 {
@@ -30,18 +136,61 @@ struct QBCEPrepro
   PCNF pcnf;
   /* Simple memory manager. */
   MemMan *mm;
-  /* Declared number of clauses in QDIMACS file. */
+  /* Declared number of clauses and maximum variable ID in QDIMACS file. */
   unsigned int declared_num_clauses;
-  /* Number of blocked clauses. */
+  VarID declared_max_var_id;
+  /* Number of blocked clauses, and the number of them eliminated by QHBCE
+     or QCBCE. */
   unsigned int cnt_blocked_clauses;
+  unsigned int cnt_extended_clauses;
   /* Stack of literals or variable IDs read during parsing. */
   LitIDStack parsed_literals;
   /* Pointer to most recently opened scope during parsing. */
   Scope *opened_scope;
   /* Every clause gets a unique ID (for debugging purposes). */
   ClauseID cur_clause_id;
+  /* Nonzero after all existential literals have been scheduled for QBCE
+     once. Later runs only re-examine literals marked as affected. */
+  unsigned int qbce_seeded;
   /* Start time of program. */
   double start_time;
+  /* Nonzero if QBCE was stopped early since the memory limit was
+     approached. The blocked clauses found so far are still valid. */
+  unsigned int mem_limit_reached;
+  /* Nonzero while parsing, where occurrences are built afterwards. */
+  unsigned int parsing;
+  /* Open-addressing hash set of the clauses parsed so far, whose size is a
+     power of two. Only used while parsing if duplicates are dropped. */
+  ClauseSetEntry *clause_set;
+  size_t clause_set_size;
+  size_t clause_set_cnt;
+  /* Open-addressing hash map of the variables declared in the prefix,
+     whose size is a power of two. Only used while parsing if variables are
+     compacted, such that the variable table is allocated for the declared
+     variables rather than for the maximum ID given in the preamble. */
+  VarMapEntry *var_map;
+  size_t var_map_size;
+  size_t var_map_cnt;
+  /* IDs the variables are printed with if they were relabeled after
+     parsing, indexed by the internal IDs, and the size of the variable table
+     for these IDs. */
+  VarID *orig_var_ids;
+  VarID orig_size_vars;
+  /* Time of the most recent checkpoint (see 'checkpoint.h'). */
+  double last_checkpoint;
+  /* Stages run by 'qbce_simplify' in this order, QBCE only by default. */
+  PipelineStage pipeline[NUM_STAGES];
+  unsigned int pipeline_len;
+  /* Nonzero if simplification produced the empty clause, i.e. the formula
+     is false. */
+  unsigned int empty_clause;
+  /* Set of the stages which changed the formula, bit 'i' for stage 'i'. */
+  unsigned int changed_stages;
+  /* Nesting level each variable can be shifted to according to the
+     dependency scheme, computed before the first use if enabled. */
+  Nesting *dep_nesting;
+  /* Performance statistics. */
+  QBCEStats stats;
 
   /* Options to be set via command line. */
   struct
@@ -53,9 +202,162 @@ struct QBCEPrepro
     unsigned int print_usage;
     unsigned int simplify;
     unsigned int print_formula;
+    /* Print the IDs of blocked clauses instead of the formula as text if 1
+       and as bitmap if 2, with their blocking literals if 'blocking_lits'
+       is nonzero (see 'qbce_print_blocked'). */
+    unsigned int print_blocked;
+    unsigned int blocking_lits;
+    unsigned int batch;
+    /* Unix domain socket served in server mode if not null. */
+    char *server;
+    unsigned int jobs;
+    char *out_dir;
+    char *stats_json;
+    unsigned int mem_limit;
+    unsigned int total_mem_limit;
+    char *pipeline;
+    /* Maximum number of literal visits for extending one clause in QHBCE
+       and QCBCE, 0 for the default. */
+    unsigned int ext_effort;
+    /* Nonzero if clauses are also extended by asymmetric literal addition
+       in QHBCE and QCBCE. */
+    unsigned int ala;
+    /* Number of clauses and literals by which bounded variable elimination
+       may increase the formula per eliminated variable. */
+    unsigned int bve_clause_bound;
+    unsigned int bve_lit_bound;
+    /* Nonzero if the level restriction of QBCE and QBLE is relaxed by the
+       standard dependency scheme. */
+    unsigned int dep_scheme;
+    /* Nonzero if duplicate clauses are dropped while parsing. */
+    unsigned int dedup;
+    /* Compact variable IDs while parsing if nonzero, and also print the
+       compacted IDs if 2, otherwise the original ones. */
+    unsigned int compact_vars;
+    /* Nonzero if variables and clauses are reordered after parsing to
+       improve locality. */
+    unsigned int reorder;
+    /* File QBCE checkpoints are written to every 'checkpoint_interval'
+       seconds if not null, and nonzero if QBCE resumes from it. */
+    char *checkpoint;
+    unsigned int checkpoint_interval;
+    unsigned int resume;
+    /* Directory of the file memory is taken from in external memory mode
+       if not null, and limit of the resident set in MB. */
+    char *external_mem;
+    unsigned int external_rss;
+    /* Number of threads formatting clauses concurrently when printing the
+       formula, serial output if at most one. */
+    unsigned int output_threads;
   } options;
 };
 
 typedef struct QBCEPrepro QBCEPrepro;
 
+/* Library interface. A formula is either read by 'parse' (see 'parse.h') or
+   built from in-memory arrays. Signal handlers, timeouts and other global
+   state are left to the application. */
+QBCEPrepro *qbce_create (void);
+
+void qbce_delete (QBCEPrepro * qr);
+
+/* Release the formula so that 'qr' can read another one. Options, the
+   pipeline and the memory manager with its pooled blocks are kept. */
+void qbce_reset (QBCEPrepro * qr);
+
+/* Like 'qbce_reset', but after an error was recovered from (see 'error.h'),
+   where the formula may be incomplete. Memory of the operation that failed
+   which is not referenced by the formula cannot be released and is only no
+   longer accounted for. */
+void qbce_recover (QBCEPrepro * qr);
+
+void qbce_declare_vars (QBCEPrepro * qr, VarID max_var_id);
+
+void qbce_add_scope (QBCEPrepro * qr, QuantifierType type, LitID * vars,
+                     unsigned int num_vars);
+
+void qbce_import_formula (QBCEPrepro * qr, VarID max_var_id,
+                          LitID * prefix, size_t prefix_len,
+                          LitID * clauses, size_t clauses_len);
+
+unsigned int qbce_num_surviving_clauses (QBCEPrepro * qr);
+
+void qbce_get_surviving_clause_ids (QBCEPrepro * qr, ClauseID * ids);
+
+void qbce_print_formula (QBCEPrepro * qr, FILE * out);
+
+/* Magic number at the start of the binary output of blocked clauses,
+   including a format version. */
+#define QBCE_BLOCKED_MAGIC "QBCEBLK1"
+
+/* Print only the blocked clauses to 'out', identified by their IDs, which
+   number the clauses from 1 in the order they were parsed or added. As
+   text, the ID of every blocked clause is printed on a line of its own,
+   followed by the literal it is blocked on if 'with_lits' is nonzero. If
+   'bitmap' is nonzero, then the output is binary: the 8 bytes of
+   'QBCE_BLOCKED_MAGIC', the number of clause IDs 'n' and 'with_lits' as
+   32-bit integers, 'ceil(n / 8)' bytes where bit 'i % 8' of byte 'i / 8'
+   is set iff clause 'i + 1' is blocked, and, if 'with_lits' is nonzero,
+   the blocking literal of every blocked clause in the order of IDs as
+   32-bit integer. Integers are written in the byte order of the host. */
+void qbce_print_blocked (QBCEPrepro * qr, FILE * out, int bitmap,
+                         int with_lits);
+
+/* Preprocessing pipeline. 'spec' is a comma-separated list of the stages
+   'ur' (universal reduction), 'up' (unit propagation), 'pure' (pure literal
+   elimination), 'qbce', 'qhbce' (hidden), 'qcbce' (covered blocked clause
+   elimination), 'qble' (blocked universal literal elimination), 'bve'
+   (bounded variable elimination) and 'sub' (subsumption), each at most once.
+   Returns zero if 'spec' is invalid. 'qbce_simplify' runs the stages in
+   this order over and over until none of them changes the formula any more,
+   and returns the number of remaining clauses. Blocked clauses are
+   considered removed by all stages. Clauses satisfied by an assignment are
+   deleted, hence clauses returned by 'qbce_add_clause' must not be used
+   after 'qbce_simplify' with stages other than QBCE. Once such a stage
+   changed the formula, no clauses can be added any more (see
+   'qbce_add_clause'). */
+int qbce_set_pipeline (QBCEPrepro * qr, const char *spec);
+
+unsigned int qbce_simplify (QBCEPrepro * qr);
+
+const char *qbce_stage_name (PipelineStage stage);
+
+/* Performance statistics. A phase is timed by enclosing it in calls of
+   'qbce_phase_start' and 'qbce_phase_stop'. */
+void qbce_phase_start (PhaseTime * t);
+
+/* Monotonic wall clock time in seconds, for timing outside of phases. */
+double qbce_wall_time (void);
+
+void qbce_phase_stop (PhaseTime * t);
+
+void qbce_print_stats_json (QBCEPrepro * qr, FILE * out, const char *name);
+
+void qbce_print_error_json (FILE * out, const char *name, const char *msg);
+
+/* Incremental QBCE: add a clause to or remove a clause from the formula and
+   re-query the set of blocked clauses. Only the literals affected by changes
+   since the previous query are re-examined. Variables of added clauses must
+   have been declared in the quantifier prefix. Clauses cannot be added once
+   the dependency scheme has been computed, since they may add dependencies
+   that blocked clauses relied on being absent. Neither can they be added
+   once a pipeline stage other than QBCE changed the formula: literals and
+   clauses deleted by these stages are deleted for good, but their deletion
+   may not be valid any more in the formula with the added clause. The
+   program aborts in both cases. Removing a clause keeps clauses blocked by
+   QBCE blocked. Clauses eliminated by QHBCE and QCBCE, however, may rely on
+   the removed clause, hence all of them are restored by
+   'qbce_remove_clause', and the next 'qbce_simplify' eliminates them again
+   where possible. Clauses cannot be removed once subsumption changed the
+   formula, since clauses subsumed by the removed one were deleted for good.
+   Restoring clauses aborts the program if the dependency scheme has been
+   computed or if stages other than QBCE, QHBCE and QCBCE changed the
+   formula. */
+Clause *qbce_add_clause (QBCEPrepro * qr, LitID * lits,
+                         unsigned int num_lits);
+
+void qbce_remove_clause (QBCEPrepro * qr, Clause * clause);
+
+unsigned int qbce_find_blocked_clauses (QBCEPrepro * qr);
+
 #endif
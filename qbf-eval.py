@@ -0,0 +1,77 @@
+#! /usr/bin/env python3
+#
+# Brute-force evaluation of small QBFs in QDIMACS format, used as reference
+# by 'run-pipeline-fuzz.sh' to check that preprocessing preserves the truth
+# value of a formula.
+#
+# Prints '1' if the formula is true and '0' if it is false. Variables which
+# do not occur in the prefix are existentially quantified in the outermost
+# block, as QDIMACS prescribes. The formula is evaluated by expanding the
+# prefix from left to right, cutting off as soon as every clause is
+# satisfied or some clause is falsified, hence only formulas with a few
+# dozen variables are feasible.
+#
+import sys
+
+
+def parse(text):
+    prefix = []
+    clauses = []
+    for line in text.splitlines():
+        tokens = line.split()
+        if not tokens or tokens[0] in ('c', 'p'):
+            continue
+        if tokens[0] in ('a', 'e'):
+            prefix.append((tokens[0], [int(x) for x in tokens[1:-1]]))
+        else:
+            clauses.append([int(x) for x in tokens[:-1]])
+    return prefix, clauses
+
+
+def evaluate(prefix, clauses):
+    order = [(q, v) for q, vs in prefix for v in vs]
+    quantified = set(v for _, v in order)
+    free = set(abs(l) for c in clauses for l in c) - quantified
+    order = [('e', v) for v in sorted(free)] + order
+    assignment = {}
+
+    def status():
+        # 0: some clause falsified, 1: all satisfied, None: undecided.
+        result = 1
+        for c in clauses:
+            undecided = False
+            for l in c:
+                value = assignment.get(abs(l))
+                if value is None:
+                    undecided = True
+                elif value == (l > 0):
+                    break
+            else:
+                if not undecided:
+                    return 0
+                result = None
+        return result
+
+    def expand(i):
+        s = status()
+        if s is not None:
+            return s
+        q, v = order[i]
+        for value in (True, False):
+            assignment[v] = value
+            r = expand(i + 1)
+            del assignment[v]
+            if q == 'e' and r:
+                return 1
+            if q == 'a' and not r:
+                return 0
+        return 1 if q == 'a' else 0
+
+    return expand(0)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 2:
+        sys.exit('usage: %s <formula>' % sys.argv[0])
+    with open(sys.argv[1]) as f:
+        print(evaluate(*parse(f.read())))
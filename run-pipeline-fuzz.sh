@@ -0,0 +1,109 @@
+#!/bin/bash
+
+# Differential fuzzing of the simplification stages: small random formulas
+# generated by qbce-gen are preprocessed with every configuration in
+# CONFIGS, and the truth value of the output, computed by the brute-force
+# evaluator qbf-eval.py, must be that of the input. Besides, test-lib
+# removes a clause after the stages of INCREMENTAL, and the truth value must
+# be that of the input without the clause, and resuming QBCE from a
+# checkpoint must give the output of running it in one go.
+#
+# usage: ./run-pipeline-fuzz.sh [number of formulas (default: 100)]
+
+NUM=${1:-100}
+
+CONFIGS=(
+    ""
+    "--pipeline=ur"
+    "--pipeline=up"
+    "--pipeline=pure"
+    "--pipeline=ur,up,pure,qbce"
+    "--pipeline=qhbce"
+    "--pipeline=qcbce"
+    "--pipeline=qhbce,qcbce --ala"
+    "--pipeline=qble"
+    "--pipeline=bve"
+    "--pipeline=sub"
+    "--pipeline=ur,up,pure,qbce,qhbce,qcbce,qble,bve,sub"
+    "--pipeline=ur,up,pure,qbce,qhbce,qcbce,qble,bve,sub --ala"
+    "--dep-scheme"
+    "--dep-scheme --pipeline=qbce,qble"
+    "--dedup"
+    "--compact-vars"
+    "--compact-vars=renumber --dedup"
+    "--reorder"
+    "--reorder --compact-vars=renumber --dedup"
+)
+
+INCREMENTAL=(
+    "qbce"
+    "qhbce"
+    "qcbce"
+    "qhbce,qcbce"
+    "qhbce,qcbce --ala"
+)
+
+TMPDIR=$(mktemp -d)
+trap 'rm -rf $TMPDIR' EXIT
+IN=$TMPDIR/in.qdimacs
+OUT=$TMPDIR/out.qdimacs
+FAILED=0
+
+# Report failure 'msg' and keep the formula.
+fail ()
+{
+    echo "FAILURE: $1, formula kept in fuzz-fail-$SEED.qdimacs"
+    cp $IN fuzz-fail-$SEED.qdimacs
+    ((FAILED++))
+}
+
+for ((SEED = 1; SEED <= NUM; SEED++))
+do
+    ./qbce-gen --vars=$((10 + SEED % 5)) --clauses=$((6 + SEED * 7 % 22)) \
+        --depth=$((2 + SEED % 3)) --min=1 --max=4 --planted=0.3 \
+        --seed=$SEED -o $IN || exit 1
+    EXPECTED=$(python3 qbf-eval.py $IN)
+
+    for OPTS in "${CONFIGS[@]}"
+    do
+        if ! ./qbce-prepro $IN --print-formula --simplify $OPTS > $OUT
+        then
+            fail "qbce-prepro $OPTS exited with error"
+        elif [[ $(python3 qbf-eval.py $OUT) != $EXPECTED ]]
+        then
+            fail "qbce-prepro $OPTS changed the truth value"
+        fi
+    done
+
+    # The expected truth value without the first clause.
+    awk '/^[pcae]/ || n++' $IN > $TMPDIR/rest.qdimacs
+    REST=$(python3 qbf-eval.py $TMPDIR/rest.qdimacs)
+    for PIPELINE in "${INCREMENTAL[@]}"
+    do
+        ./test-lib --incremental=$PIPELINE $IN > $OUT
+        RES=$?
+        if ((RES == 1 || RES > 2))
+        then
+            fail "test-lib --incremental=$PIPELINE exited with error"
+        elif ((RES == 0)) && [[ $(python3 qbf-eval.py $OUT) != $REST ]]
+        then
+            fail "removing a clause after $PIPELINE changed the truth value"
+        fi
+    done
+
+    # Resume from a checkpoint written in the last round of QBCE, which
+    # must give the same result as running QBCE in one go.
+    ./test-lib --checkpoint=$TMPDIR/checkpoint $IN \
+        || fail "resuming from a checkpoint in the library"
+    ./qbce-prepro $IN --print-formula --simplify > $TMPDIR/plain.qdimacs
+    if ! ./qbce-prepro $IN --print-formula --simplify \
+        --checkpoint=$TMPDIR/checkpoint --resume > $OUT \
+        || ! cmp -s $OUT $TMPDIR/plain.qdimacs
+    then
+        fail "resuming from a checkpoint changes the output"
+    fi
+    rm -f $TMPDIR/checkpoint
+done
+
+echo "$NUM formulas, $FAILED failures"
+((FAILED == 0))
@@ -0,0 +1,262 @@
+/*
+ This file is part of qbce-prepro.
+
+ Copyright 2018 
+ Florian Lonsing, Vienna University of Technology, Austria.
+
+ qbce-prepro is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or (at
+ your option) any later version.
+
+ qbce-prepro is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with qbce-prepro.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.h"
+#include "parse.h"
+#include "error.h"
+
+/* Maximum number of accepted connections waiting for a worker. Further
+   clients wait in the backlog of the socket. */
+#define SERVER_MAX_QUEUED 64
+
+/* Limits on reading the rest of a failed request, such that a client
+   keeping the connection open cannot tie up a worker. */
+#define SERVER_DRAIN_SECONDS 2
+#define SERVER_DRAIN_MAX_BYTES (16 << 20)
+
+/* Shared state of the worker threads. Accepted connections are queued in
+   'queue[head % SERVER_MAX_QUEUED..(tail - 1) % SERVER_MAX_QUEUED]'. */
+struct Server
+{
+  QBCEPrepro *settings;
+  /* Accounts for the memory of all formulas being processed, the memory
+     managers of the workers are attached to it. */
+  MemMan *mm;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int queue[SERVER_MAX_QUEUED];
+  unsigned int head;
+  unsigned int tail;
+  /* Number of connections accepted so far, names formulas in logs and
+     statistics. */
+  unsigned int num_requests;
+};
+
+typedef struct Server Server;
+
+/* Write the statistics of 'qr' to 'out' as QDIMACS comment lines. */
+static void
+print_stats_comment (QBCEPrepro * qr, FILE * out, const char *name)
+{
+  char *json;
+  size_t size;
+  FILE *mem = open_memstream (&json, &size);
+  ABORT_APP (!mem, "could not allocate memory!");
+  qbce_print_stats_json (qr, mem, name);
+  fclose (mem);
+  char *line, *next;
+  for (line = json; *line; line = next)
+    {
+      next = strchr (line, '\n');
+      next = next ? next + 1 : line + strlen (line);
+      fprintf (out, "c %.*s", (int) (next - line), line);
+    }
+  free (json);
+}
+
+/* Report error 'msg' of request 'name' to the client by 'out' and to the
+   log, then read the rest of the request from 'in' such that closing the
+   connection does not reset it before the client received the error. The
+   rest is read for at most 'SERVER_DRAIN_SECONDS' and up to
+   'SERVER_DRAIN_MAX_BYTES', after which the connection is closed anyway. */
+static void
+fail_request (Server * s, FILE * in, FILE * out, const char *name,
+              const char *msg)
+{
+  int len = strlen (msg);
+  /* Drop the trailing newline of some messages. */
+  while (len && msg[len - 1] == '\n')
+    len--;
+  if (s->settings->options.verbosity >= 1)
+    fprintf (stderr, "%s: error: %.*s\n", name, len, msg);
+  /* Output of the failed request may be incomplete. */
+  fprintf (out, "c error: %.*s\n", len, msg);
+  fflush (out);
+  shutdown (fileno (out), SHUT_WR);
+  int fd = fileno (in);
+  struct timeval timeout = { SERVER_DRAIN_SECONDS, 0 };
+  setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+  double deadline = qbce_wall_time () + SERVER_DRAIN_SECONDS;
+  size_t drained = 0;
+  ssize_t num;
+  char buf[4096];
+  /* Bytes still buffered by 'in' are dropped with it. */
+  while (drained < SERVER_DRAIN_MAX_BYTES && qbce_wall_time () < deadline
+         && (num = read (fd, buf, sizeof (buf))) > 0)
+    drained += num;
+}
+
+/* Preprocess the formula read from connection 'fd' and send the result. A
+   malformed formula or exceeding the memory limit fails this request only,
+   the error is sent to the client and 'qr' is reset for the next request. */
+static void
+serve_request (Server * s, QBCEPrepro * qr, int fd, unsigned int id)
+{
+  double start = qbce_wall_time ();
+  char name[32];
+  sprintf (name, "request-%u", id);
+  FILE *in = fdopen (fd, "r");
+  int out_fd = dup (fd);
+  FILE *out = out_fd < 0 ? 0 : fdopen (out_fd, "w");
+  if (!in || !out)
+    {
+      fprintf (stderr, "%s: could not open connection!\n", name);
+      if (out)
+        fclose (out);
+      else if (out_fd >= 0)
+        close (out_fd);
+      if (in)
+        fclose (in);
+      else
+        close (fd);
+      return;
+    }
+
+  jmp_buf recover;
+  if (setjmp (recover))
+    {
+      fail_request (s, in, out, name, qbce_error_msg);
+      fclose (out);
+      fclose (in);
+      qbce_recover (qr);
+      return;
+    }
+  qbce_error_jmp = &recover;
+  parse (qr, in);
+  ABORT_APP (qr->declared_num_clauses > qr->cur_clause_id,
+             "declared number of clauses exceeds actual number of clauses!");
+  qbce_simplify (qr);
+  if (qr->options.print_blocked)
+    qbce_print_blocked (qr, out, qr->options.print_blocked == 2,
+                        qr->options.blocking_lits);
+  else
+    qbce_print_formula (qr, out);
+  print_stats_comment (qr, out, name);
+  qbce_error_jmp = 0;
+  fclose (out);
+  fclose (in);
+
+  if (s->settings->options.verbosity >= 1)
+    fprintf (stderr, "%s: %u vars, %u clauses, %u blocked, %.3f s\n", name,
+             qr->pcnf.size_vars ? qr->pcnf.size_vars - 1 : 0,
+             qr->pcnf.clauses.cnt, qr->cnt_blocked_clauses,
+             qbce_wall_time () - start);
+  qbce_reset (qr);
+}
+
+/* Worker thread: serves queued connections one after the other with the
+   same QBCEPrepro object. */
+static void *
+worker_thread (void *arg)
+{
+  Server *s = arg;
+  QBCEPrepro *qr = qbce_create ();
+  qr->options = s->settings->options;
+  mm_set_parent (qr->mm, s->mm);
+  if (qr->options.pipeline)
+    qbce_set_pipeline (qr, qr->options.pipeline);
+  if (qr->options.mem_limit)
+    mm_set_mem_limit (qr->mm, qr->options.mem_limit);
+
+  for (;;)
+    {
+      pthread_mutex_lock (&s->lock);
+      while (s->head == s->tail)
+        pthread_cond_wait (&s->cond, &s->lock);
+      int fd = s->queue[s->head++ % SERVER_MAX_QUEUED];
+      unsigned int id = ++s->num_requests;
+      pthread_cond_broadcast (&s->cond);
+      pthread_mutex_unlock (&s->lock);
+      serve_request (s, qr, fd, id);
+    }
+  return 0;
+}
+
+void
+run_server (const char *socket_path, QBCEPrepro * settings)
+{
+  struct sockaddr_un addr;
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  ABORT_APP (strlen (socket_path) >= sizeof (addr.sun_path),
+             "socket path too long!");
+  strcpy (addr.sun_path, socket_path);
+
+  int sock = socket (AF_UNIX, SOCK_STREAM, 0);
+  ABORT_APP (sock < 0, "could not create socket!");
+  /* Remove the socket of a previous server. */
+  unlink (socket_path);
+  ABORT_APP (bind (sock, (struct sockaddr *) &addr, sizeof (addr)),
+             "could not bind socket!");
+  ABORT_APP (listen (sock, SOMAXCONN), "could not listen on socket!");
+  /* A client closing its connection early must not terminate the server. */
+  signal (SIGPIPE, SIG_IGN);
+
+  Server s;
+  memset (&s, 0, sizeof (Server));
+  s.settings = settings;
+  s.mm = mm_create ();
+  if (settings->options.total_mem_limit)
+    mm_set_mem_limit (s.mm, settings->options.total_mem_limit);
+  pthread_mutex_init (&s.lock, 0);
+  pthread_cond_init (&s.cond, 0);
+
+  unsigned int i, num_workers = settings->options.jobs;
+  assert (num_workers > 0);
+  pthread_t thread;
+  for (i = 0; i < num_workers; i++)
+    {
+      ABORT_APP (pthread_create (&thread, 0, worker_thread, &s),
+                 "could not create thread!");
+      pthread_detach (thread);
+    }
+  if (settings->options.verbosity >= 1)
+    fprintf (stderr, "listening on '%s' with %u workers\n", socket_path,
+             num_workers);
+
+  for (;;)
+    {
+      int fd = accept (sock, 0, 0);
+      if (fd < 0)
+        continue;
+      pthread_mutex_lock (&s.lock);
+      while (s.tail - s.head == SERVER_MAX_QUEUED)
+        pthread_cond_wait (&s.cond, &s.lock);
+      s.queue[s.tail++ % SERVER_MAX_QUEUED] = fd;
+      pthread_cond_broadcast (&s.cond);
+      pthread_mutex_unlock (&s.lock);
+    }
+}
@@ -0,0 +1,43 @@
+/*
+ This file is part of qbce-prepro.
+
+ Copyright 2018 
+ Florian Lonsing, Vienna University of Technology, Austria.
+
+ qbce-prepro is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or (at
+ your option) any later version.
+
+ qbce-prepro is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with qbce-prepro.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#ifndef SERVER_H_INCLUDED
+#define SERVER_H_INCLUDED
+
+#include "qbce-prepro.h"
+
+/* Listen on the Unix domain socket 'socket_path' and preprocess one formula
+   per connection. A client writes a QDIMACS formula and shuts down its
+   side of the connection for writing, then reads the simplified formula,
+   or the blocked clauses if 'print_blocked' is set, followed by the
+   statistics in JSON with every line prefixed by "c ". If the formula is
+   malformed or exceeds the memory limit, the client reads a single line
+   "c error: <message>" instead and the server goes on. Connections are
+   served by 'settings->options.jobs' worker threads, each of which reuses
+   one QBCEPrepro object and its memory manager for all the formulas it
+   processes. The options and the pipeline of 'settings' apply to every
+   formula, where 'mem_limit' limits the memory per formula and
+   'total_mem_limit' that of all formulas processed at the same time. Does
+   not return. */
+void run_server (const char *socket_path, QBCEPrepro * settings);
+
+#endif
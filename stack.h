@@ -39,7 +39,7 @@
       {									\
 	size_t elem_bytes = sizeof(*(stack).start);			\
 	size_t old_count = COUNT_STACK (stack);			\
-	(stack).start = mm_realloc((mm), (stack).start,		\
+	(stack).start = mm_stack_realloc((mm), (stack).start,		\
 				      old_size * elem_bytes,		\
 				      (size) * elem_bytes);		\
 	(stack).top = (stack).start + old_count;			\
@@ -56,7 +56,7 @@
 
 #define DELETE_STACK(mm, stack)					\
   do {									\
-    mm_free((mm), (stack).start,					\
+    mm_stack_free((mm), (stack).start,				\
 	       SIZE_STACK(stack) * sizeof(*(stack).start));	\
     INIT_STACK ((stack));						\
   } while (0)
@@ -67,7 +67,7 @@
     new_size = old_size ? 2 * old_size : 1;				\
     size_t old_count = COUNT_STACK (stack);			\
     size_t elem_bytes = sizeof(*(stack).start);				\
-    (stack).start = mm_realloc((mm), (stack).start,			\
+    (stack).start = mm_stack_realloc((mm), (stack).start,			\
 				  old_size*elem_bytes,			\
 				  new_size*elem_bytes);			\
     (stack).top = (stack).start + old_count;				\
@@ -0,0 +1,344 @@
+/*
+ This file is part of qbce-prepro.
+
+ Copyright 2018
+ Florian Lonsing, Vienna University of Technology, Austria.
+
+ qbce-prepro is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or (at
+ your option) any later version.
+
+ qbce-prepro is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with qbce-prepro.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Tests of the library interface which the command line cannot reach.
+   Without arguments, fixed regression cases are run. The other modes work
+   on a formula file, checking the incremental interface and checkpoints
+   written in the middle of QBCE. Exits with 1 if a check fails. */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "qbce-prepro.h"
+#include "parse.h"
+#include "checkpoint.h"
+#include "error.h"
+
+#define TEST_USAGE \
+"usage: ./test-lib [mode <formula>]\n"\
+"\n"\
+"  without arguments, run the regression cases of the incremental interface\n"\
+"\n"\
+"    --check <f>        check that incremental QBCE after removing or adding\n"\
+"                         a clause agrees with QBCE from scratch\n"\
+"    --incremental=<pipeline> [--ala] <f>\n"\
+"                       simplify by <pipeline>, remove the first clause,\n"\
+"                         simplify again and print the formula; exits with\n"\
+"                         2 if the clause cannot be removed\n"\
+"    --print-stream <f> check that printing the simplified formula to a stream\n"\
+"                         without file descriptor, serially and in parallel,\n"\
+"                         gives the output printed to a file\n"\
+"    --checkpoint=<c> <f>\n"\
+"                       run QBCE writing a checkpoint to <c> at the start of\n"\
+"                         every round, and check that resuming from the\n"\
+"                         last one gives the same result\n"\
+"\n"
+
+/* Maximum number of clauses removed one at a time by '--check'. */
+#define TEST_MAX_REMOVALS 32
+
+static unsigned int num_failed;
+
+#define CHECK(cond, name)                                               \
+  do {                                                                  \
+    if (!(cond))                                                        \
+      {                                                                 \
+        fprintf (stderr, "FAILED: %s (line %d)\n", name, __LINE__);     \
+        num_failed++;                                                   \
+      }                                                                 \
+  } while (0)
+
+static QBCEPrepro *
+read_formula (const char *path)
+{
+  FILE *in = fopen (path, "r");
+  ABORT_APP (!in, "could not open input file!");
+  QBCEPrepro *qr = qbce_create ();
+  parse (qr, in);
+  fclose (in);
+  return qr;
+}
+
+static Clause *
+find_clause (QBCEPrepro * qr, ClauseID id)
+{
+  Clause *c;
+  for (c = qr->pcnf.clauses.first; c; c = c->link.next)
+    if (c->id == id)
+      return c;
+  return 0;
+}
+
+/* Return nonzero if the same clauses, by ID, survived in 'a' and 'b'. */
+static int
+same_survivors (QBCEPrepro * a, QBCEPrepro * b)
+{
+  unsigned int num = qbce_num_surviving_clauses (a);
+  if (num != qbce_num_surviving_clauses (b))
+    return 0;
+  ClauseID *ids_a = malloc ((num + 1) * sizeof (ClauseID));
+  ClauseID *ids_b = malloc ((num + 1) * sizeof (ClauseID));
+  ABORT_APP (!ids_a || !ids_b, "could not allocate memory!");
+  qbce_get_surviving_clause_ids (a, ids_a);
+  qbce_get_surviving_clause_ids (b, ids_b);
+  int same = !memcmp (ids_a, ids_b, num * sizeof (ClauseID));
+  free (ids_a);
+  free (ids_b);
+  return same;
+}
+
+/* -------------------- START: REGRESSION CASES -------------------- */
+
+/* Run 'qbce_add_clause' on 'qr' and return nonzero if it failed. */
+static int
+add_clause_fails (QBCEPrepro * qr, LitID * lits, unsigned int num_lits)
+{
+  jmp_buf recover;
+  if (setjmp (recover))
+    return 1;
+  qbce_error_jmp = &recover;
+  qbce_add_clause (qr, lits, num_lits);
+  qbce_error_jmp = 0;
+  return 0;
+}
+
+/* Clauses blocked by QBCE are unblocked by an added clause they clash
+   with, and blocked again once it is removed. */
+static void
+test_qbce_add_remove (void)
+{
+  QBCEPrepro *qr = qbce_create ();
+  LitID prefix[] = { QTYPE_EXISTS, 1, 2, 0 };
+  LitID clauses[] = { 1, 2, 0, 1, -2, 0 };
+  qbce_import_formula (qr, 2, prefix, 4, clauses, 6);
+  CHECK (qbce_simplify (qr) == 0, "qbce blocks all clauses");
+  LitID unit[] = { -1 };
+  Clause *added = qbce_add_clause (qr, unit, 1);
+  CHECK (qbce_simplify (qr) == 3, "added clause unblocks clauses");
+  qbce_remove_clause (qr, added);
+  CHECK (qbce_simplify (qr) == 0, "removed clause blocks clauses again");
+  qbce_delete (qr);
+}
+
+/* A pure literal elimination of 1 in (1 2)(1 -2) is not valid any more
+   after (-1) is added, which turns the formula false, hence adding clauses
+   must be rejected once other stages than QBCE changed the formula. */
+static void
+test_add_after_pure (void)
+{
+  QBCEPrepro *qr = qbce_create ();
+  qbce_set_pipeline (qr, "pure");
+  LitID prefix[] = { QTYPE_EXISTS, 1, 2, 0 };
+  LitID clauses[] = { 1, 2, 0, 1, -2, 0 };
+  qbce_import_formula (qr, 2, prefix, 4, clauses, 6);
+  qbce_simplify (qr);
+  LitID unit[] = { -1 };
+  CHECK (add_clause_fails (qr, unit, 1), "add clause after pure rejected");
+  qbce_recover (qr);
+  qbce_delete (qr);
+}
+
+/* (-1 2 3) is eliminated by QHBCE with the hidden literal 2 of (-1 2).
+   Once (-1 2) is removed, the false formula (-1 2 3)(1)(-2)(-3) remains,
+   hence the elimination must be undone. */
+static void
+test_remove_hidden_premise (void)
+{
+  QBCEPrepro *qr = qbce_create ();
+  qbce_set_pipeline (qr, "qhbce");
+  LitID prefix[] = { QTYPE_EXISTS, 1, 2, 3, 0 };
+  LitID clauses[] = { -1, 2, 0, -1, 2, 3, 0, 1, 0, -2, 0, -3, 0 };
+  qbce_import_formula (qr, 3, prefix, 5, clauses, 13);
+  qbce_simplify (qr);
+  qbce_remove_clause (qr, find_clause (qr, 1));
+  CHECK (qbce_simplify (qr) == 4, "hidden elimination undone");
+  CHECK (!find_clause (qr, 2)->blocked, "clause 2 restored");
+  qbce_delete (qr);
+}
+
+/* -------------------- END: REGRESSION CASES -------------------- */
+
+/* -------------------- START: FORMULA MODES -------------------- */
+
+/* QBCE has a unique fixed point, hence removing a clause or adding one
+   after QBCE must give the same blocked clauses as doing so before. */
+static void
+check_incremental_qbce (const char *path)
+{
+  QBCEPrepro *full = read_formula (path);
+  unsigned int num_clauses = full->pcnf.clauses.cnt;
+  ClauseID id;
+  for (id = 1; id <= num_clauses && id <= TEST_MAX_REMOVALS; id++)
+    {
+      QBCEPrepro *inc = read_formula (path), *ref = read_formula (path);
+      qbce_simplify (inc);
+      qbce_remove_clause (inc, find_clause (inc, id));
+      qbce_simplify (inc);
+      qbce_remove_clause (ref, find_clause (ref, id));
+      qbce_simplify (ref);
+      CHECK (same_survivors (inc, ref), "incremental removal");
+
+      /* Add the clause again with its first literal negated, which
+         clashes with the clauses blocked on that literal. */
+      Clause *c = find_clause (full, id);
+      unsigned int num_lits = c->num_lits;
+      LitID *lits = malloc (num_lits * sizeof (LitID));
+      ABORT_APP (!lits, "could not allocate memory!");
+      memcpy (lits, c->lits, num_lits * sizeof (LitID));
+      lits[0] = -lits[0];
+      qbce_add_clause (inc, lits, num_lits);
+      qbce_simplify (inc);
+      qbce_add_clause (ref, lits, num_lits);
+      qbce_simplify (ref);
+      CHECK (same_survivors (inc, ref), "incremental addition");
+      free (lits);
+      qbce_delete (inc);
+      qbce_delete (ref);
+    }
+  qbce_delete (full);
+}
+
+/* Print the formula simplified by 'pipeline', with asymmetric literal
+   addition if 'ala' is nonzero, after removing the first clause. Returns 2
+   if removing clauses is not supported after the stages which changed the
+   formula. */
+static int
+remove_first_clause (const char *pipeline, int ala, const char *path)
+{
+  QBCEPrepro *qr = read_formula (path);
+  ABORT_APP (!qbce_set_pipeline (qr, pipeline), "invalid pipeline!");
+  qr->options.ala = ala;
+  qbce_simplify (qr);
+  jmp_buf recover;
+  if (setjmp (recover))
+    {
+      qbce_recover (qr);
+      qbce_delete (qr);
+      return 2;
+    }
+  qbce_error_jmp = &recover;
+  if (qr->pcnf.clauses.first)
+    qbce_remove_clause (qr, qr->pcnf.clauses.first);
+  qbce_error_jmp = 0;
+  qbce_simplify (qr);
+  qbce_print_formula (qr, stdout);
+  qbce_delete (qr);
+  return 0;
+}
+
+/* Print the simplified formula to a memory stream, which has no file
+   descriptor, by 'num_threads' threads and return the output. */
+static char *
+print_to_memstream (QBCEPrepro * qr, unsigned int num_threads, size_t * len)
+{
+  char *buf;
+  FILE *out = open_memstream (&buf, len);
+  ABORT_APP (!out, "could not open memory stream!");
+  qr->options.output_threads = num_threads;
+  qbce_print_formula (qr, out);
+  fclose (out);
+  return buf;
+}
+
+/* The output printed to a stream without file descriptor must be that
+   printed to a file. */
+static void
+check_print_stream (const char *path)
+{
+  QBCEPrepro *qr = read_formula (path);
+  qbce_simplify (qr);
+  FILE *file = tmpfile ();
+  ABORT_APP (!file, "could not open temporary file!");
+  qbce_print_formula (qr, file);
+  long file_len = ftell (file);
+  char *expected = malloc (file_len + 1);
+  ABORT_APP (!expected, "could not allocate memory!");
+  rewind (file);
+  CHECK (fread (expected, 1, file_len, file) == (size_t) file_len,
+         "read back file output");
+  fclose (file);
+
+  unsigned int num_threads;
+  for (num_threads = 1; num_threads <= 4; num_threads *= 4)
+    {
+      size_t len;
+      char *buf = print_to_memstream (qr, num_threads, &len);
+      CHECK (len == (size_t) file_len && !memcmp (buf, expected, len),
+             "print to memory stream");
+      free (buf);
+    }
+  free (expected);
+  qbce_delete (qr);
+}
+
+/* Run QBCE with checkpoints written as often as possible, which is at the
+   start of every round. Checks that resuming from the checkpoint of the
+   last round gives the same blocked clauses. */
+static void
+write_checkpoints (char *checkpoint, const char *path)
+{
+  QBCEPrepro *qr = read_formula (path);
+  qr->options.checkpoint = checkpoint;
+  qr->options.checkpoint_interval = 0;
+  qbce_simplify (qr);
+
+  QBCEPrepro *resumed = read_formula (path);
+  CHECK (qbce_read_checkpoint (resumed, checkpoint) == 1,
+         "checkpoint readable");
+  qbce_simplify (resumed);
+  CHECK (same_survivors (qr, resumed), "resume from checkpoint");
+  qbce_delete (resumed);
+  qbce_delete (qr);
+}
+
+/* -------------------- END: FORMULA MODES -------------------- */
+
+int
+main (int argc, char **argv)
+{
+  if (argc == 1)
+    {
+      test_qbce_add_remove ();
+      test_add_after_pure ();
+      test_remove_hidden_premise ();
+      if (!num_failed)
+        fprintf (stderr, "all regression cases passed\n");
+    }
+  else if (argc == 3 && !strcmp (argv[1], "--check"))
+    check_incremental_qbce (argv[2]);
+  else if ((argc == 3 || (argc == 4 && !strcmp (argv[2], "--ala")))
+           && !strncmp (argv[1], "--incremental=", strlen ("--incremental=")))
+    return remove_first_clause (argv[1] + strlen ("--incremental="),
+                                argc == 4, argv[argc - 1]);
+  else if (argc == 3 && !strcmp (argv[1], "--print-stream"))
+    check_print_stream (argv[2]);
+  else if (argc == 3 && !strncmp (argv[1], "--checkpoint=",
+                                  strlen ("--checkpoint=")))
+    write_checkpoints (argv[1] + strlen ("--checkpoint="), argv[2]);
+  else
+    {
+      fprintf (stderr, TEST_USAGE);
+      return 1;
+    }
+  return num_failed ? 1 : 0;
+}
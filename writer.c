@@ -0,0 +1,483 @@
+/*
+ This file is part of qbce-prepro.
+
+ Copyright 2018 
+ Florian Lonsing, Vienna University of Technology, Austria.
+
+ qbce-prepro is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or (at
+ your option) any later version.
+
+ qbce-prepro is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with qbce-prepro.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "writer.h"
+#include "error.h"
+
+/* Size of the output buffer in bytes. */
+#define WRITER_BUF_SIZE (1 << 20)
+
+/* Maximum number of bytes emitted for one integer and its separator. */
+#define WRITER_MAX_INT_BYTES 12
+
+/* Write 'num' bytes of 'buf' by 'w', retrying on short writes. Once
+   writing failed, all further output of 'w' is dropped. */
+static void
+write_all (Writer * w, const char *buf, size_t num)
+{
+  if (w->fd < 0)
+    {
+      if (num && !w->failed && fwrite (buf, 1, num, w->out) != num)
+        w->failed = 1;
+      return;
+    }
+  while (num && !w->failed)
+    {
+      ssize_t written = write (w->fd, buf, num);
+      if (written < 0 && errno == EINTR)
+        continue;
+      if (written <= 0)
+        {
+          w->failed = 1;
+          return;
+        }
+      buf += written;
+      num -= written;
+    }
+}
+
+/* Make sure that at least 'num' bytes are available in the buffer. */
+#define WRITER_RESERVE(w, num)                 \
+  do {                                         \
+    if ((size_t) ((w)->end - (w)->pos) < (num)) \
+      writer_flush ((w));                      \
+  } while (0)
+
+/* Format 'num' at 'pos' and return pointer to the byte after the last
+   digit. Digits are produced from right to left in a small scratch array. */
+static char *
+format_int (char *pos, int num)
+{
+  char digits[WRITER_MAX_INT_BYTES], *d = digits + WRITER_MAX_INT_BYTES;
+  /* Negate as unsigned to handle INT_MIN. */
+  unsigned int u = num < 0 ? -(unsigned int) num : (unsigned int) num;
+  do
+    {
+      *--d = '0' + u % 10;
+      u /= 10;
+    }
+  while (u);
+  if (num < 0)
+    *pos++ = '-';
+  size_t len = digits + WRITER_MAX_INT_BYTES - d;
+  memcpy (pos, d, len);
+  return pos + len;
+}
+
+/* Set up writer 'w' for the file descriptor of 'out'. Data pending in the
+   buffer of 'out' is flushed first to keep the order of the output. Streams
+   without a file descriptor, like those of 'open_memstream', are written
+   by 'fwrite' instead. */
+void
+writer_init (Writer * w, MemMan * mm, FILE * out)
+{
+  fflush (out);
+  w->mm = mm;
+  w->out = out;
+  w->fd = fileno (out);
+  w->failed = 0;
+  /* Output must not fail due to the memory limit, hence fall back to a small
+     buffer. */
+  size_t size = WRITER_BUF_SIZE;
+  if (!(w->buf = mm_try_malloc (mm, size)))
+    {
+      w->buf = w->fallback;
+      size = WRITER_FALLBACK_SIZE;
+    }
+  w->pos = w->buf;
+  w->end = w->buf + size;
+}
+
+/* Flush and release the buffer. A failed write is reported only here,
+   after the buffer was released, such that the error can be recovered from
+   (see 'error.h'). */
+void
+writer_delete (Writer * w)
+{
+  writer_flush (w);
+  if (w->fd < 0 && !w->failed && fflush (w->out))
+    w->failed = 1;
+  if (w->buf != w->fallback)
+    mm_free (w->mm, w->buf, WRITER_BUF_SIZE);
+  w->buf = w->pos = w->end = 0;
+  ABORT_APP (w->failed, "could not write output!");
+}
+
+void
+writer_flush (Writer * w)
+{
+  write_all (w, w->buf, w->pos - w->buf);
+  w->pos = w->buf;
+}
+
+void
+writer_put_bytes (Writer * w, const void *bytes, size_t len)
+{
+  if (len > (size_t) (w->end - w->buf))
+    {
+      writer_flush (w);
+      write_all (w, bytes, len);
+      return;
+    }
+  WRITER_RESERVE (w, len);
+  memcpy (w->pos, bytes, len);
+  w->pos += len;
+}
+
+void
+writer_put_str (Writer * w, const char *str)
+{
+  writer_put_bytes (w, str, strlen (str));
+}
+
+void
+writer_put_int (Writer * w, int num)
+{
+  WRITER_RESERVE (w, WRITER_MAX_INT_BYTES);
+  w->pos = format_int (w->pos, num);
+}
+
+void
+writer_put_lits (Writer * w, LitID * lits, unsigned int num)
+{
+  LitID *p, *e;
+  for (p = lits, e = p + num; p < e; p++)
+    {
+      WRITER_RESERVE (w, WRITER_MAX_INT_BYTES);
+      w->pos = format_int (w->pos, *p);
+      *w->pos++ = ' ';
+    }
+  WRITER_RESERVE (w, 2);
+  *w->pos++ = '0';
+  *w->pos++ = '\n';
+}
+
+void
+writer_put_mapped_lits (Writer * w, LitID * lits, unsigned int num,
+                        const VarID * map)
+{
+  LitID *p, *e;
+  for (p = lits, e = p + num; p < e; p++)
+    {
+      WRITER_RESERVE (w, WRITER_MAX_INT_BYTES);
+      LitID lit = *p < 0 ? -(LitID) map[-*p] : (LitID) map[*p];
+      w->pos = format_int (w->pos, lit);
+      *w->pos++ = ' ';
+    }
+  WRITER_RESERVE (w, 2);
+  *w->pos++ = '0';
+  *w->pos++ = '\n';
+}
+
+
+/* Parallel output of clauses. Worker threads claim chunks of consecutive
+   clauses in the order of the list and format them into the buffers of a
+   ring of slots, while the calling thread writes formatted chunks in order,
+   passing all chunks ready at the same time to one call of 'writev'. A
+   chunk takes clauses as long as their formatted size is guaranteed to fit
+   into 'WRITER_BUF_SIZE' bytes. A clause exceeding this on its own forms a
+   chunk of its own which is written by the calling thread directly. */
+
+/* Number of slots per worker thread. */
+#define WRITER_SLOTS_PER_THREAD 2
+
+/* Number of buffers passed to one call of 'writev', the minimum of
+   'IOV_MAX' guaranteed by POSIX. */
+#define WRITER_MAX_IOV 16
+
+/* Upper bound on the formatted size of a clause with 'num' literals. */
+#define WRITER_CLAUSE_BYTES(num) ((size_t) (num) * WRITER_MAX_INT_BYTES + 2)
+
+enum SlotState
+{
+  SLOT_FREE,
+  SLOT_CLAIMED,
+  SLOT_FORMATTED
+};
+
+struct WriterSlot
+{
+  char *buf;
+  size_t len;
+  /* First clause and number of clauses in the list, including blocked
+     ones, of the chunk. */
+  Clause *first;
+  unsigned int num_clauses;
+  /* Nonzero if the chunk does not fit into 'buf'. */
+  int direct;
+  enum SlotState state;
+};
+
+typedef struct WriterSlot WriterSlot;
+
+struct ParallelWriter
+{
+  const VarID *map;
+  WriterSlot *slots;
+  unsigned int num_slots;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  /* First clause not claimed yet. */
+  Clause *cursor;
+  /* Sequence numbers of the next chunk to be claimed and written. The
+     chunk with sequence number 'k' is formatted in slot 'k % num_slots'. */
+  unsigned long long next_claim;
+  unsigned long long next_write;
+};
+
+typedef struct ParallelWriter ParallelWriter;
+
+static char *
+format_lits (char *pos, LitID * lits, unsigned int num, const VarID * map)
+{
+  LitID *p, *e;
+  for (p = lits, e = p + num; p < e; p++)
+    {
+      LitID lit = !map ? *p : *p < 0 ? -(LitID) map[-*p] : (LitID) map[*p];
+      pos = format_int (pos, lit);
+      *pos++ = ' ';
+    }
+  *pos++ = '0';
+  *pos++ = '\n';
+  return pos;
+}
+
+/* Claim the clauses of the next chunk for slot 's'. Called with the lock
+   held. */
+static void
+claim_chunk (ParallelWriter * pw, WriterSlot * s)
+{
+  size_t bytes = 0;
+  unsigned int num = 0;
+  Clause *c;
+  for (c = pw->cursor; c; c = c->link.next, num++)
+    if (!c->blocked)
+      {
+        size_t clause_bytes = WRITER_CLAUSE_BYTES (c->num_lits);
+        if (bytes && bytes + clause_bytes > WRITER_BUF_SIZE)
+          break;
+        bytes += clause_bytes;
+      }
+  s->first = pw->cursor;
+  s->num_clauses = num;
+  s->direct = bytes > WRITER_BUF_SIZE;
+  s->state = SLOT_CLAIMED;
+  pw->cursor = c;
+  pw->next_claim++;
+}
+
+static void *
+format_thread (void *arg)
+{
+  ParallelWriter *pw = arg;
+  pthread_mutex_lock (&pw->lock);
+  while (pw->cursor)
+    {
+      if (pw->next_claim - pw->next_write >= pw->num_slots)
+        {
+          pthread_cond_wait (&pw->cond, &pw->lock);
+          continue;
+        }
+      WriterSlot *s = pw->slots + pw->next_claim % pw->num_slots;
+      claim_chunk (pw, s);
+      pthread_mutex_unlock (&pw->lock);
+
+      if (!s->direct)
+        {
+          char *pos = s->buf;
+          Clause *c = s->first;
+          unsigned int i;
+          for (i = 0; i < s->num_clauses; i++, c = c->link.next)
+            if (!c->blocked)
+              pos = format_lits (pos, c->lits, c->num_lits, pw->map);
+          s->len = pos - s->buf;
+        }
+
+      pthread_mutex_lock (&pw->lock);
+      s->state = SLOT_FORMATTED;
+      pthread_cond_broadcast (&pw->cond);
+    }
+  pthread_mutex_unlock (&pw->lock);
+  return 0;
+}
+
+/* Write all bytes of 'iov' by 'w', retrying on short writes, like
+   'write_all'. */
+static void
+writev_all (Writer * w, struct iovec *iov, int num)
+{
+  if (w->fd < 0)
+    {
+      for (; num; iov++, num--)
+        write_all (w, iov->iov_base, iov->iov_len);
+      return;
+    }
+  while (num && !w->failed)
+    {
+      ssize_t written = writev (w->fd, iov, num);
+      if (written < 0 && errno == EINTR)
+        continue;
+      if (written <= 0)
+        {
+          w->failed = 1;
+          return;
+        }
+      while (num && (size_t) written >= iov->iov_len)
+        {
+          written -= iov->iov_len;
+          iov++;
+          num--;
+        }
+      if (num)
+        {
+          iov->iov_base = (char *) iov->iov_base + written;
+          iov->iov_len -= written;
+        }
+    }
+}
+
+/* Write the clauses of the chunk in slot 's' which did not fit into its
+   buffer by 'w'. */
+static void
+write_direct (Writer * w, WriterSlot * s, const VarID * map)
+{
+  Clause *c = s->first;
+  unsigned int i;
+  for (i = 0; i < s->num_clauses; i++, c = c->link.next)
+    if (!c->blocked)
+      {
+        if (map)
+          writer_put_mapped_lits (w, c->lits, c->num_lits, map);
+        else
+          writer_put_lits (w, c->lits, c->num_lits);
+      }
+  writer_flush (w);
+}
+
+void
+writer_put_clauses (Writer * w, Clause * first, const VarID * map,
+                    unsigned int num_threads)
+{
+  ParallelWriter pw;
+  memset (&pw, 0, sizeof (ParallelWriter));
+  pw.map = map;
+  pw.cursor = first;
+  pw.num_slots = num_threads * WRITER_SLOTS_PER_THREAD;
+  pw.slots = num_threads > 1 ?
+    mm_try_malloc (w->mm, pw.num_slots * sizeof (WriterSlot)) : 0;
+  unsigned int i;
+  for (i = 0; pw.slots && i < pw.num_slots; i++)
+    if (!(pw.slots[i].buf = mm_try_malloc (w->mm, WRITER_BUF_SIZE)))
+      break;
+  /* Output must not fail due to the memory limit, hence fall back to
+     writing serially. */
+  if (!pw.slots || i < pw.num_slots)
+    {
+      while (pw.slots && i-- > 0)
+        mm_free (w->mm, pw.slots[i].buf, WRITER_BUF_SIZE);
+      if (pw.slots)
+        mm_free (w->mm, pw.slots, pw.num_slots * sizeof (WriterSlot));
+      Clause *c;
+      for (c = first; c; c = c->link.next)
+        if (!c->blocked)
+          {
+            if (map)
+              writer_put_mapped_lits (w, c->lits, c->num_lits, map);
+            else
+              writer_put_lits (w, c->lits, c->num_lits);
+          }
+      return;
+    }
+
+  writer_flush (w);
+  pthread_mutex_init (&pw.lock, 0);
+  pthread_cond_init (&pw.cond, 0);
+  pthread_t *threads = mm_malloc (w->mm, num_threads * sizeof (pthread_t));
+  /* Abort only while no thread runs, else continue with fewer threads. */
+  for (i = 0; i < num_threads; i++)
+    if (pthread_create (threads + i, 0, format_thread, &pw))
+      break;
+  ABORT_APP (!i, "could not create thread!");
+  unsigned int num_started = i;
+
+  struct iovec iov[WRITER_MAX_IOV];
+  pthread_mutex_lock (&pw.lock);
+  while (pw.cursor || pw.next_write < pw.next_claim)
+    {
+      WriterSlot *s = pw.slots + pw.next_write % pw.num_slots;
+      if (pw.next_write == pw.next_claim || s->state != SLOT_FORMATTED)
+        {
+          pthread_cond_wait (&pw.cond, &pw.lock);
+          continue;
+        }
+      /* Collect the chunks formatted in order, or take a single chunk
+         which is written directly. */
+      unsigned int num = 0;
+      unsigned long long k = pw.next_write;
+      if (s->direct)
+        k++;
+      else
+        for (; k < pw.next_claim && num < WRITER_MAX_IOV; k++)
+          {
+            WriterSlot *t = pw.slots + k % pw.num_slots;
+            if (t->state != SLOT_FORMATTED || t->direct)
+              break;
+            /* Chunks of blocked clauses only are empty. */
+            if (t->len)
+              {
+                iov[num].iov_base = t->buf;
+                iov[num++].iov_len = t->len;
+              }
+          }
+      pthread_mutex_unlock (&pw.lock);
+      if (s->direct)
+        write_direct (w, s, map);
+      else
+        writev_all (w, iov, num);
+      pthread_mutex_lock (&pw.lock);
+      /* Stop claiming chunks once writing failed, the chunks claimed
+         already are still waited for. */
+      if (w->failed)
+        pw.cursor = 0;
+      for (; pw.next_write < k; pw.next_write++)
+        pw.slots[pw.next_write % pw.num_slots].state = SLOT_FREE;
+      pthread_cond_broadcast (&pw.cond);
+    }
+  pthread_mutex_unlock (&pw.lock);
+
+  for (i = 0; i < num_started; i++)
+    pthread_join (threads[i], 0);
+  mm_free (w->mm, threads, num_threads * sizeof (pthread_t));
+  pthread_cond_destroy (&pw.cond);
+  pthread_mutex_destroy (&pw.lock);
+  for (i = 0; i < pw.num_slots; i++)
+    mm_free (w->mm, pw.slots[i].buf, WRITER_BUF_SIZE);
+  mm_free (w->mm, pw.slots, pw.num_slots * sizeof (WriterSlot));
+}
@@ -0,0 +1,83 @@
+/*
+ This file is part of qbce-prepro.
+
+ Copyright 2018 
+ Florian Lonsing, Vienna University of Technology, Austria.
+
+ qbce-prepro is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or (at
+ your option) any later version.
+
+ qbce-prepro is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with qbce-prepro.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef WRITER_H_INCLUDED
+#define WRITER_H_INCLUDED
+
+#include <stddef.h>
+#include <stdio.h>
+#include "mem.h"
+#include "pcnf.h"
+
+/* Buffered writer emitting QDIMACS text directly to a file descriptor. Integers
+   are formatted by hand into a large buffer which is flushed by 'write(2)',
+   which avoids the per-call overhead of 'fprintf'. The buffer is passed to
+   'fwrite' for streams without a file descriptor. */
+/* Size of the buffer used if the memory limit does not allow for the large
+   one. */
+#define WRITER_FALLBACK_SIZE 4096
+
+struct Writer
+{
+  MemMan *mm;
+  FILE *out;
+  /* File descriptor of 'out', or negative if it has none. */
+  int fd;
+  char *buf;
+  char *pos;
+  char *end;
+  /* Nonzero once writing failed, see 'writer_delete'. */
+  int failed;
+  char fallback[WRITER_FALLBACK_SIZE];
+};
+
+typedef struct Writer Writer;
+
+void writer_init (Writer * w, MemMan * mm, FILE * out);
+
+void writer_delete (Writer * w);
+
+void writer_flush (Writer * w);
+
+/* Write 'len' bytes of 'bytes' as they are. */
+void writer_put_bytes (Writer * w, const void *bytes, size_t len);
+
+void writer_put_str (Writer * w, const char *str);
+
+void writer_put_int (Writer * w, int num);
+
+/* Write the 'num' literals in 'lits' followed by '0' and a newline. */
+void writer_put_lits (Writer * w, LitID * lits, unsigned int num);
+
+/* Like 'writer_put_lits', but write 'map[v]' instead of variable 'v'. */
+void writer_put_mapped_lits (Writer * w, LitID * lits, unsigned int num,
+                             const VarID * map);
+
+/* Write the clauses in the list starting at 'first' which are not blocked,
+   mapping variables by 'map' unless it is null. The clauses are formatted
+   by 'num_threads' threads concurrently and written in order of the list,
+   producing the same bytes as 'writer_put_lits' on each clause. Falls back
+   to writing serially if 'num_threads' is at most one or if the buffers
+   cannot be allocated. */
+void writer_put_clauses (Writer * w, Clause * first, const VarID * map,
+                         unsigned int num_threads);
+
+#endif